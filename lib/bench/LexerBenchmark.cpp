@@ -0,0 +1,88 @@
+#include "maxlang/lexer.h"
+#include "maxlang/scanner.h"
+#include "fmt/format.h"
+#include <chrono>
+#include <functional>
+#include <string>
+
+using namespace maxlang;
+
+namespace {
+    std::string repeat(size_t bytes, const std::function<std::string(int)>& chunk) {
+        std::string code;
+        for (int i = 0; code.size() < bytes; ++i) {
+            code += chunk(i);
+        }
+        return code;
+    }
+
+    // Скрипт в духе примеров из README: таблицы, комментарии, строки и отступы
+    std::string makeScript(size_t bytes) {
+        return repeat(bytes, [](int i) {
+            return fmt::format(R"(
+/* Board {0}:
+ * a block comment spanning
+ * several lines
+ */
+fn board_{0}(size, fill) {{
+    // build the rows
+    rows = [];
+    for (row = 0; row < size; row++) {{
+        cells = ["first_cell_{0}", "second_cell", 'x', {0}.5, 1000000 + {0}];
+        rows[row] = cells;
+    }}
+    return rows;
+}}
+)", i);
+        });
+    }
+
+    // Глубокие отступы и пустые строки между короткими операторами
+    std::string makeWhitespace(size_t bytes) {
+        return repeat(bytes, [](int i) {
+            return fmt::format("\n\n{0}value_{1} = {1};\n\t\t\t\t\n{0}    total = total + value_{1};\n\n",
+                               std::string(48, ' '), i);
+        });
+    }
+
+    // Документированный код: длинные комментарии на каждый оператор
+    std::string makeComments(size_t bytes) {
+        return repeat(bytes, [](int i) {
+            return fmt::format(R"(
+/*
+ * Step {0}. The accumulator keeps the running total of every value seen so far;
+ * the loop below walks the table row by row and never revisits a cell.
+ * See the README for the full description of the table layout.
+ */
+total = total + {0}; // add the step number to the running total of the table
+// the next statement resets the cursor back to the first row of the table
+cursor = 0;
+)", i);
+        });
+    }
+}
+
+int main() {
+    constexpr size_t kBytes = 16 * 1024 * 1024;
+    constexpr int kRuns = 10;
+    const std::pair<const char*, std::string> inputs[] = {
+        {"mixed", makeScript(kBytes)},
+        {"whitespace", makeWhitespace(kBytes)},
+        {"comments", makeComments(kBytes)},
+    };
+
+    for (const auto& [title, code] : inputs) {
+        fmt::print("{}:\n", title);
+        for (int isa = 0; isa <= static_cast<int>(lexer::scan::best()); ++isa) {
+            lexer::scan::use(static_cast<lexer::scan::Isa>(isa));
+            size_t tokens = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (int run = 0; run < kRuns; ++run) {
+                tokens += lexer::process(code).size();
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            fmt::print("{:>8}: {:8.1f} MB/s, {} tokens\n", lexer::scan::name(lexer::scan::active()),
+                       code.size() * kRuns / elapsed.count() / (1024 * 1024), tokens / kRuns);
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace maxlang {
+    /**
+     * @brief Bump allocator that owns the strings an expression tree refers to.
+     *
+     * Memory is handed out from large blocks and is only released all at once, when the arena is
+     * destroyed.
+     */
+    class Arena {
+    public:
+        static constexpr size_t kBlockSize = 64 * 1024;
+
+        Arena() = default;
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        /**
+         * @brief Returns uninitialized memory; `alignment` must not exceed that of std::max_align_t.
+         */
+        void* allocate(size_t size, size_t alignment) {
+            auto offset = (mOffset + alignment - 1) & ~(alignment - 1);
+            if (mBlocks.empty() || offset + size > mBlockSize) {
+                // Крупные объекты получают собственный блок
+                mBlockSize = std::max(size, kBlockSize);
+                mBlocks.emplace_back(new std::byte[mBlockSize]);
+                offset = 0;
+            }
+            mOffset = offset + size;
+            return mBlocks.back().get() + offset;
+        }
+
+        std::string_view copy(std::string_view text) {
+            if (text.empty()) {
+                return {};
+            }
+            auto* data = static_cast<char*>(allocate(text.size(), 1));
+            std::memcpy(data, text.data(), text.size());
+            return { data, text.size() };
+        }
+
+    private:
+        std::vector<std::unique_ptr<std::byte[]>> mBlocks;
+        size_t mBlockSize = 0;
+        size_t mOffset = 0;
+    };
+}
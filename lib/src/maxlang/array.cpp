@@ -1,6 +1,9 @@
 #include "array.h"
 #include "util.h"
 #include <iostream>
+#include <algorithm>
+#include <iterator>
+#include <vector>
 /*werwerwer*/
 namespace maxlang {
 
@@ -12,13 +15,47 @@ namespace maxlang {
                     [&](std::monostate) { os << "<void>"; },
                     [&](int v) { os << v; },
                     [&](double v) { os << v; },
-                    [&](const std::string& v) { os << v; },
+                    [&](const String& v) { os << v; },
                     [&](char c) { os << c; },
+                    [&](const ArrayRef& array) { os << array; },
                 },
                 value);
         }
 
+        /**
+         * @brief Marks an array as being printed; a cycle (`a[0] = a`) is printed as `[...]`.
+         */
+        class Printing {
+        public:
+            explicit Printing(const Array& array) {
+                mCycle = std::ranges::find(stack(), &array) != stack().end();
+                if (!mCycle) {
+                    stack().push_back(&array);
+                }
+            }
+            ~Printing() {
+                if (!mCycle) {
+                    stack().pop_back();
+                }
+            }
+
+            bool cycle() const { return mCycle; }
+
+        private:
+            static std::vector<const Array*>& stack() {
+                thread_local std::vector<const Array*> arrays;
+                return arrays;
+            }
+
+            bool mCycle;
+        };
+
         void impl_array(std::ostream& os, const Array& array) {
+            Printing printing(array);
+            if (printing.cycle()) {
+                os << "[...]";
+                return;
+            }
             os << "[";
             for (size_t i = 0; i < array.elements.size(); ++i) {
                 printValue(os, array.elements[i]); // Используем нашу функцию
@@ -36,6 +73,7 @@ namespace maxlang {
     }
 
     void printArray(std::ostream& os, const Array& array) {
+        Printing printing(array);
         os << "Array '" << array.name << "': [";
         for (size_t i = 0; i < array.elements.size(); ++i) {
             printValue(os, array.elements[i]); // Используем нашу функцию
@@ -45,4 +83,117 @@ namespace maxlang {
         }
         os << "]";
     }
-}
\ No newline at end of file
+}
+maxlang::Array::Array(std::vector<Value> elements, std::shared_ptr<ArrayHeap> heap)
+    : elements(std::move(elements)), mHeap(std::move(heap)) {
+    mNext = mHeap->mFirst;
+    if (mNext) {
+        mNext->mPrevious = this;
+    }
+    mHeap->mFirst = this;
+    ++mHeap->mCount;
+}
+
+void maxlang::Array::destroy(Array* array) {
+    // Деструктор массива освобождает вложенные массивы и снова попадает сюда: они только
+    // добавляются в очередь, а удаляет их внешний вызов
+    thread_local std::vector<Array*> pending;
+    thread_local bool destroying = false;
+    pending.push_back(array);
+    if (destroying) {
+        return;
+    }
+    destroying = true;
+    while (!pending.empty()) {
+        auto* next = pending.back();
+        pending.pop_back();
+        delete next;
+    }
+    destroying = false;
+}
+
+maxlang::Array::~Array() {
+    if (!mHeap) {
+        return;
+    }
+    if (mPrevious) {
+        mPrevious->mNext = mNext;
+    } else {
+        mHeap->mFirst = mNext;
+    }
+    if (mNext) {
+        mNext->mPrevious = mPrevious;
+    }
+    --mHeap->mCount;
+}
+
+maxlang::ArrayRef maxlang::ArrayHeap::make(std::vector<Value> elements) {
+    if (mCount >= mCollectThreshold) {
+        collectCycles();
+        mCollectThreshold = std::max(kMinCollectThreshold, mCount * 2);
+    }
+    return ArrayRef(new Array(std::move(elements), shared_from_this()));
+}
+
+size_t maxlang::ArrayHeap::bytes() const {
+    size_t result = 0;
+    for (auto* array = mFirst; array; array = array->mNext) {
+        result += sizeof(Array) + array->elements.capacity() * sizeof(Value);
+    }
+    return result;
+}
+
+size_t maxlang::ArrayHeap::collectCycles() {
+    // Пробное удаление: вычитаем ссылки, идущие из массивов этой кучи.
+    // Всё, на что остались внешние ссылки (регистры, переменные, хост), живо.
+    auto forEachChild = [this](Array& array, auto&& f) {
+        for (auto& element : array.elements) {
+            if (auto* child = std::get_if<ArrayRef>(&element); child && child->get()->mHeap.get() == this) {
+                f(*child->get());
+            }
+        }
+    };
+
+    for (auto* array = mFirst; array; array = array->mNext) {
+        array->mCollectorReferences = array->mReferences;
+        array->mReachable = false;
+    }
+    for (auto* array = mFirst; array; array = array->mNext) {
+        forEachChild(*array, [](Array& child) { --child.mCollectorReferences; });
+    }
+
+    std::vector<Array*> pending;
+    for (auto* array = mFirst; array; array = array->mNext) {
+        if (array->mCollectorReferences > 0) {
+            array->mReachable = true;
+            pending.push_back(array);
+        }
+    }
+    while (!pending.empty()) {
+        auto* array = pending.back();
+        pending.pop_back();
+        forEachChild(*array, [&](Array& child) {
+            if (!child.mReachable) {
+                child.mReachable = true;
+                pending.push_back(&child);
+            }
+        });
+    }
+
+    // Держим мусор живым, пока разрываем циклы, затем отпускаем
+    std::vector<ArrayRef> garbage;
+    for (auto* array = mFirst; array; array = array->mNext) {
+        if (!array->mReachable) {
+            garbage.emplace_back(array);
+        }
+    }
+    std::vector<Value> released;
+    for (auto& array : garbage) {
+        std::move(array->elements.begin(), array->elements.end(), std::back_inserter(released));
+        array->elements.clear();
+    }
+    released.clear();
+    size_t freed = garbage.size();
+    garbage.clear();
+    return freed;
+}
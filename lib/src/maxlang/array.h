@@ -1,12 +1,15 @@
 #pragma once
 
 #include "value.h" // ДОБАВЬТЕ ЭТУ СТРОКУ
+#include <cstdint>
 #include <vector>
 #include <memory>
 #include <string>
 #include <iostream>
 
 namespace maxlang {
+    class ArrayHeap;
+
     struct Array {
         std::vector<Value> elements;
         std::string name; // Имя для отладки
@@ -15,6 +18,11 @@ namespace maxlang {
         explicit Array(const std::string& name) : name(name) {}
         explicit Array(std::vector<Value> elements, const std::string& name = "")
             : elements(std::move(elements)), name(name) {}
+        Array(std::vector<Value> elements, std::shared_ptr<ArrayHeap> heap);
+        ~Array();
+
+        Array(const Array&) = delete;
+        Array& operator=(const Array&) = delete;
 
         Value& operator[](size_t index) {
             if (index >= elements.size()) {
@@ -55,8 +63,76 @@ namespace maxlang {
         bool operator!=(const Array& other) const {
             return !(*this == other);
         }
+
+    private:
+        friend class ArrayRef;
+        friend class ArrayHeap;
+
+        /**
+         * @brief Deletes an array whose last reference went away. Nested arrays released by it are
+         * deleted by the same loop, so long chains do not overflow the native stack.
+         */
+        static void destroy(Array* array);
+
+        uint32_t mReferences = 0;
+
+        // Учёт в куче контекста (для массивов, созданных через ArrayHeap::make)
+        std::shared_ptr<ArrayHeap> mHeap;
+        Array* mPrevious = nullptr;
+        Array* mNext = nullptr;
+        size_t mCollectorReferences = 0;
+        bool mReachable = false;
+    };
+
+    /**
+     * @brief Arrays created by one context.
+     *
+     * Arrays are freed by reference counting as soon as they become unreachable. Arrays that
+     * only reference each other (`a[0] = a`) are found by a cycle collector that runs when the
+     * number of live arrays doubles. Like Context, a heap must be used by one thread at a time.
+     */
+    class ArrayHeap : public std::enable_shared_from_this<ArrayHeap> {
+    public:
+        ArrayRef make(std::vector<Value> elements);
+
+        /**
+         * @brief Number of live arrays.
+         */
+        size_t count() const { return mCount; }
+
+        /**
+         * @brief Memory held by live arrays: headers and element storage, not string contents.
+         */
+        size_t bytes() const;
+
+        /**
+         * @brief Frees arrays that are only reachable from other garbage. Returns how many were freed.
+         */
+        size_t collectCycles();
+
+    private:
+        friend struct Array;
+
+        static constexpr size_t kMinCollectThreshold = 1024;
+
+        Array* mFirst = nullptr;
+        size_t mCount = 0;
+        size_t mCollectThreshold = kMinCollectThreshold;
     };
 
+    inline void ArrayRef::retain() const {
+        if (mArray) {
+            ++mArray->mReferences;
+        }
+    }
+
+    inline void ArrayRef::release() {
+        if (mArray && --mArray->mReferences == 0) {
+            Array::destroy(mArray);
+        }
+        mArray = nullptr;
+    }
+
     void printArray(std::ostream& os, const Array& array);
     std::ostream& operator<<(std::ostream& os, const Array& array);
 }
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include "bytecode.h"
+#include "fmt/format.h"
+
+namespace maxlang::bytecode {
+
+    namespace {
+        const char* opName(OpCode op) {
+            switch (op) {
+                case OpCode::LoadConstant: return "LoadConstant";
+                case OpCode::Move: return "Move";
+                case OpCode::LoadGlobal: return "LoadGlobal";
+                case OpCode::StoreGlobal: return "StoreGlobal";
+                case OpCode::Undefined: return "Undefined";
+                case OpCode::CheckDefined: return "CheckDefined";
+                case OpCode::Add: return "Add";
+                case OpCode::Subtract: return "Subtract";
+                case OpCode::Multiply: return "Multiply";
+                case OpCode::Divide: return "Divide";
+                case OpCode::Equal: return "Equal";
+                case OpCode::NotEqual: return "NotEqual";
+                case OpCode::Less: return "Less";
+                case OpCode::Greater: return "Greater";
+                case OpCode::LessEqual: return "LessEqual";
+                case OpCode::GreaterEqual: return "GreaterEqual";
+                case OpCode::Increment: return "Increment";
+                case OpCode::Decrement: return "Decrement";
+                case OpCode::AddInt: return "AddInt";
+                case OpCode::SubtractInt: return "SubtractInt";
+                case OpCode::MultiplyInt: return "MultiplyInt";
+                case OpCode::EqualInt: return "EqualInt";
+                case OpCode::NotEqualInt: return "NotEqualInt";
+                case OpCode::LessInt: return "LessInt";
+                case OpCode::GreaterInt: return "GreaterInt";
+                case OpCode::LessEqualInt: return "LessEqualInt";
+                case OpCode::GreaterEqualInt: return "GreaterEqualInt";
+                case OpCode::AddDouble: return "AddDouble";
+                case OpCode::SubtractDouble: return "SubtractDouble";
+                case OpCode::MultiplyDouble: return "MultiplyDouble";
+                case OpCode::DivideDouble: return "DivideDouble";
+                case OpCode::LessDouble: return "LessDouble";
+                case OpCode::GreaterDouble: return "GreaterDouble";
+                case OpCode::LessEqualDouble: return "LessEqualDouble";
+                case OpCode::GreaterEqualDouble: return "GreaterEqualDouble";
+                case OpCode::NewArray: return "NewArray";
+                case OpCode::GetIndex: return "GetIndex";
+                case OpCode::SetIndex: return "SetIndex";
+                case OpCode::IterNext: return "IterNext";
+                case OpCode::Jump: return "Jump";
+                case OpCode::JumpIfFalse: return "JumpIfFalse";
+                case OpCode::Call: return "Call";
+                case OpCode::TailCall: return "TailCall";
+                case OpCode::DefineFunction: return "DefineFunction";
+                case OpCode::Return: return "Return";
+                case OpCode::ReturnVoid: return "ReturnVoid";
+            }
+            return "Unknown";
+        }
+    }   // namespace
+
+    OpCode intForm(OpCode op) {
+        switch (op) {
+            case OpCode::Add: return OpCode::AddInt;
+            case OpCode::Subtract: return OpCode::SubtractInt;
+            case OpCode::Multiply: return OpCode::MultiplyInt;
+            case OpCode::Equal: return OpCode::EqualInt;
+            case OpCode::NotEqual: return OpCode::NotEqualInt;
+            case OpCode::Less: return OpCode::LessInt;
+            case OpCode::Greater: return OpCode::GreaterInt;
+            case OpCode::LessEqual: return OpCode::LessEqualInt;
+            case OpCode::GreaterEqual: return OpCode::GreaterEqualInt;
+            default: return op;
+        }
+    }
+
+    OpCode doubleForm(OpCode op) {
+        switch (op) {
+            case OpCode::Add: return OpCode::AddDouble;
+            case OpCode::Subtract: return OpCode::SubtractDouble;
+            case OpCode::Multiply: return OpCode::MultiplyDouble;
+            case OpCode::Divide: return OpCode::DivideDouble;
+            case OpCode::Less: return OpCode::LessDouble;
+            case OpCode::Greater: return OpCode::GreaterDouble;
+            case OpCode::LessEqual: return OpCode::LessEqualDouble;
+            case OpCode::GreaterEqual: return OpCode::GreaterEqualDouble;
+            default: return op;
+        }
+    }
+
+    OpCode genericForm(OpCode op) {
+        switch (op) {
+            case OpCode::AddInt: return OpCode::Add;
+            case OpCode::SubtractInt: return OpCode::Subtract;
+            case OpCode::MultiplyInt: return OpCode::Multiply;
+            case OpCode::EqualInt: return OpCode::Equal;
+            case OpCode::NotEqualInt: return OpCode::NotEqual;
+            case OpCode::LessInt: return OpCode::Less;
+            case OpCode::GreaterInt: return OpCode::Greater;
+            case OpCode::LessEqualInt: return OpCode::LessEqual;
+            case OpCode::GreaterEqualInt: return OpCode::GreaterEqual;
+            case OpCode::AddDouble: return OpCode::Add;
+            case OpCode::SubtractDouble: return OpCode::Subtract;
+            case OpCode::MultiplyDouble: return OpCode::Multiply;
+            case OpCode::DivideDouble: return OpCode::Divide;
+            case OpCode::LessDouble: return OpCode::Less;
+            case OpCode::GreaterDouble: return OpCode::Greater;
+            case OpCode::LessEqualDouble: return OpCode::LessEqual;
+            case OpCode::GreaterEqualDouble: return OpCode::GreaterEqual;
+            default: return op;
+        }
+    }
+
+    std::string disassemble(const Chunk& chunk) {
+        std::string result;
+        for (size_t pc = 0; pc < chunk.code.size(); ++pc) {
+            const auto& instruction = chunk.code[pc];
+            switch (instruction.op) {
+                case OpCode::Jump:
+                    result += fmt::format("{:4} {:<14} -> {}\n", pc, opName(instruction.op), instruction.target());
+                    break;
+                case OpCode::JumpIfFalse:
+                    result += fmt::format("{:4} {:<14} {} -> {}\n", pc, opName(instruction.op), instruction.a,
+                        instruction.target());
+                    break;
+                default:
+                    result += fmt::format("{:4} {:<14} {} {} {}\n", pc, opName(instruction.op), instruction.a,
+                        instruction.b, instruction.c);
+                    break;
+            }
+        }
+        return result;
+    }
+
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "value.h"
+
+namespace maxlang {
+    struct Function;
+}
+
+/**
+ * @details
+ * Bytecode executed by the register VM. Every chunk owns a window of registers
+ * `R[0..registerCount)`; instructions address registers, constants `K[...]`, names `N[...]`
+ * and global variables `G[...]` of the chunk by index. Local variables of a function live
+ * in registers, its parameters in `R[0..parameters)`.
+ */
+namespace maxlang::bytecode {
+    enum class OpCode : uint8_t {
+        LoadConstant,   // R[a] = K[b]
+        Move,           // R[a] = R[b]
+        LoadGlobal,     // R[a] = G[b]
+        StoreGlobal,    // G[b] = R[a]
+        Undefined,      // throw "Variable not found: N[b]"
+        CheckDefined,   // if R[a] is void: throw "Variable not found: N[b]" (see compiler.cpp)
+
+        Add,            // R[a] = R[b] + R[c]
+        Subtract,       // R[a] = R[b] - R[c]
+        Multiply,       // R[a] = R[b] * R[c]
+        Divide,         // R[a] = R[b] / R[c]
+        Equal,          // R[a] = R[b] == R[c]
+        NotEqual,       // R[a] = R[b] != R[c]
+        Less,           // R[a] = R[b] < R[c]
+        Greater,        // R[a] = R[b] > R[c]
+        LessEqual,      // R[a] = R[b] <= R[c]
+        GreaterEqual,   // R[a] = R[b] >= R[c]
+        Increment,      // R[a] = R[b] + 1, R[b] must be an integer
+        Decrement,      // R[a] = R[b] - 1, R[b] must be an integer
+
+        // Специализированные формы операций выше. VM переписывает в них операцию, увидев
+        // операнды одного типа, и возвращает обобщённую форму, если типы изменятся.
+        AddInt,
+        SubtractInt,
+        MultiplyInt,
+        EqualInt,
+        NotEqualInt,
+        LessInt,
+        GreaterInt,
+        LessEqualInt,
+        GreaterEqualInt,
+        AddDouble,
+        SubtractDouble,
+        MultiplyDouble,
+        DivideDouble,
+        LessDouble,
+        GreaterDouble,
+        LessEqualDouble,
+        GreaterEqualDouble,
+
+        NewArray,       // R[a] = [R[b], ..., R[b + c - 1]]
+        GetIndex,       // R[a] = R[b][R[c]]
+        SetIndex,       // R[a][R[b]] = R[c]
+        IterNext,       // if R[b] < length(R[a]): R[c] = R[a][R[b]++] and skip the next instruction
+
+        Jump,           // pc = target
+        JumpIfFalse,    // if R[a] == 0: pc = target
+
+        Call,           // R[a] = functions[N[b]](R[a], ..., R[a + c - 1])
+        TailCall,       // as Call; a user function replaces the current frame and returns for it
+        DefineFunction, // functions[P[a].name] = P[a]
+        Return,         // return R[a]
+        ReturnVoid,     // return <void>
+    };
+
+    struct Instruction {
+        // Изменяется VM во время выполнения (см. AddInt и далее). Код может выполняться в
+        // нескольких потоках сразу, поэтому VM обращается к op и deoptimizations атомарно
+        mutable OpCode op;
+        mutable uint8_t deoptimizations = 0;
+        uint16_t a = 0;
+        uint16_t b = 0;
+        uint16_t c = 0;
+
+        /**
+         * @brief Jump instructions keep their 32-bit target in b (low half) and c (high half).
+         */
+        uint32_t target() const { return b | (static_cast<uint32_t>(c) << 16); }
+
+        void setTarget(uint32_t target) {
+            b = static_cast<uint16_t>(target & 0xffff);
+            c = static_cast<uint16_t>(target >> 16);
+        }
+    };
+
+    static_assert(sizeof(Instruction) == 8);
+
+    /**
+     * @brief Specialized form of a generic arithmetic or comparison op for int or double
+     * operands, or `op` itself if there is none.
+     */
+    OpCode intForm(OpCode op);
+    OpCode doubleForm(OpCode op);
+
+    /**
+     * @brief Generic form of a specialized op, or `op` itself.
+     */
+    OpCode genericForm(OpCode op);
+
+    /**
+     * @brief Function resolved by the Call instructions of a chunk that use one name, valid while
+     * the context's Functions::version() equals `version`. Caches belong to a context, not to the
+     * chunk (see Function::Linkage), so chunks stay shareable between threads.
+     */
+    struct CallCache {
+        uint64_t version = 0;
+        const Function* function = nullptr;
+    };
+
+    struct Prototype;
+
+    struct Chunk {
+        std::vector<Instruction> code;
+        std::vector<Value> constants;
+        std::vector<std::string> names;
+        std::vector<std::string> globals;
+        std::vector<std::shared_ptr<const Prototype>> prototypes;
+        uint16_t registerCount = 0;
+    };
+
+    /**
+     * @brief Compiled body of a user function.
+     */
+    struct Prototype {
+        std::string name;
+        std::vector<std::string> parameters;
+        Chunk chunk;
+
+        // Для анализа чистоты (см. Memo): тело не работает с массивами и не определяет функций,
+        // а вызывает только функции из calls
+        bool selfContained = true;
+        std::vector<std::string> calls;
+    };
+
+    /**
+     * @brief A prototype bound to one context: its call caches, one per name N[...], next to the
+     * shared code.
+     */
+    struct Binding {
+        std::shared_ptr<const Prototype> prototype;
+        std::vector<CallCache> callCaches;
+    };
+
+    /**
+     * @brief Human-readable listing of a chunk, used for debugging the compiler.
+     */
+    std::string disassemble(const Chunk& chunk);
+}
@@ -0,0 +1,321 @@
+#include "cache.h"
+#include "util.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+using namespace maxlang;
+
+namespace {
+    constexpr char kMagic[4] = { 'M', 'P', 'P', 'C' };
+
+    enum class Tag : uint8_t {
+        Void,
+        Int,
+        Double,
+        String,
+        Char,
+    };
+
+    /**
+     * @brief Checks that every operand of every instruction refers to something the chunk has,
+     * so that a malformed cache cannot make the VM read out of bounds. Throws otherwise.
+     */
+    void validate(const bytecode::Chunk& chunk) {
+        using bytecode::OpCode;
+
+        auto check = [](bool valid) {
+            if (!valid) {
+                throw std::runtime_error("Malformed instruction");
+            }
+        };
+        auto registers = [&](size_t first, size_t count = 1) { check(first + count <= chunk.registerCount); };
+        auto jump = [&](const bytecode::Instruction& i) { check(i.target() < chunk.code.size()); };
+
+        // Выполнение не должно уходить за конец кода
+        check(!chunk.code.empty());
+        auto last = chunk.code.back().op;
+        check(last == OpCode::Return || last == OpCode::ReturnVoid || last == OpCode::Jump);
+
+        for (size_t k = 0; k < chunk.code.size(); ++k) {
+            const auto& i = chunk.code[k];
+            switch (i.op) {
+                case OpCode::LoadConstant:
+                    registers(i.a);
+                    check(i.b < chunk.constants.size());
+                    break;
+                case OpCode::LoadGlobal:
+                case OpCode::StoreGlobal:
+                    registers(i.a);
+                    check(i.b < chunk.globals.size());
+                    break;
+                case OpCode::Undefined:
+                case OpCode::CheckDefined:
+                    registers(i.a);
+                    check(i.b < chunk.names.size());
+                    break;
+                case OpCode::Move:
+                case OpCode::Increment:
+                case OpCode::Decrement:
+                    registers(i.a);
+                    registers(i.b);
+                    break;
+                case OpCode::NewArray:
+                    registers(i.a);
+                    registers(i.b, i.c);
+                    break;
+                case OpCode::IterNext:
+                    // Пропускает следующую инструкцию, значит, она должна быть
+                    check(k + 1 < chunk.code.size());
+                    [[fallthrough]];
+                case OpCode::GetIndex:
+                case OpCode::SetIndex:
+                    registers(i.a);
+                    registers(i.b);
+                    registers(i.c);
+                    break;
+                case OpCode::Jump:
+                    jump(i);
+                    break;
+                case OpCode::JumpIfFalse:
+                    registers(i.a);
+                    jump(i);
+                    break;
+                case OpCode::Call:
+                case OpCode::TailCall:
+                    registers(i.a, std::max<size_t>(i.c, 1));
+                    check(i.b < chunk.names.size());
+                    break;
+                case OpCode::DefineFunction:
+                    check(i.a < chunk.prototypes.size());
+                    break;
+                case OpCode::Return:
+                    registers(i.a);
+                    break;
+                case OpCode::ReturnVoid:
+                    break;
+                default:
+                    // Арифметика и сравнения во всех формах: R[a] = R[b] op R[c]
+                    check(i.op <= OpCode::ReturnVoid);
+                    registers(i.a);
+                    registers(i.b);
+                    registers(i.c);
+                    break;
+            }
+        }
+    }
+
+    class Writer {
+    public:
+        template <typename T>
+            requires std::is_trivially_copyable_v<T>
+        void put(T value) {
+            mData.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        void put(std::string_view text) {
+            put(static_cast<uint32_t>(text.size()));
+            mData.append(text);
+        }
+
+        void put(const std::vector<std::string>& strings) {
+            put(static_cast<uint32_t>(strings.size()));
+            for (const auto& string : strings) {
+                put(std::string_view(string));
+            }
+        }
+
+        void put(const Value& value) {
+            std::visit(
+                match {
+                    [&](std::monostate) { put(Tag::Void); },
+                    [&](int v) { put(Tag::Int); put(v); },
+                    [&](double v) { put(Tag::Double); put(v); },
+                    [&](const String& v) { put(Tag::String); put(v.view()); },
+                    [&](char v) { put(Tag::Char); put(v); },
+                    [&](const ArrayRef&) { throw std::runtime_error("Array constants cannot be cached"); },
+                },
+                value);
+        }
+
+        void put(const bytecode::Chunk& chunk) {
+            put(static_cast<uint32_t>(chunk.code.size()));
+            for (auto instruction : chunk.code) {
+                // Специализации и счётчики VM не сохраняются
+                instruction.op = bytecode::genericForm(instruction.op);
+                instruction.deoptimizations = 0;
+                put(instruction);
+            }
+            put(static_cast<uint32_t>(chunk.constants.size()));
+            for (const auto& constant : chunk.constants) {
+                put(constant);
+            }
+            put(chunk.names);
+            put(chunk.globals);
+            put(static_cast<uint32_t>(chunk.prototypes.size()));
+            for (const auto& prototype : chunk.prototypes) {
+                put(std::string_view(prototype->name));
+                put(prototype->parameters);
+                put(prototype->chunk);
+                put(prototype->selfContained);
+                put(prototype->calls);
+            }
+            put(chunk.registerCount);
+        }
+
+        std::string take() { return std::move(mData); }
+
+    private:
+        std::string mData;
+    };
+
+    /**
+     * @brief Reads what Writer wrote; throws on truncated or malformed data.
+     */
+    class Reader {
+    public:
+        explicit Reader(std::string_view data) : mData(data) {}
+
+        template <typename T>
+            requires std::is_trivially_copyable_v<T>
+        T get() {
+            T value;
+            std::memcpy(&value, bytes(sizeof(T)), sizeof(T));
+            return value;
+        }
+
+        std::string_view text() {
+            auto size = get<uint32_t>();
+            return { bytes(size), size };
+        }
+
+        std::vector<std::string> strings() {
+            std::vector<std::string> result(count(sizeof(uint32_t)));
+            for (auto& string : result) {
+                string = text();
+            }
+            return result;
+        }
+
+        Value value() {
+            switch (get<Tag>()) {
+                case Tag::Void: return {};
+                case Tag::Int: return get<int>();
+                case Tag::Double: return get<double>();
+                case Tag::String: return String(text());
+                case Tag::Char: return get<char>();
+            }
+            throw std::runtime_error("Unknown constant");
+        }
+
+        bytecode::Chunk chunk() {
+            bytecode::Chunk chunk;
+            chunk.code.resize(count(sizeof(bytecode::Instruction)));
+            for (auto& instruction : chunk.code) {
+                instruction = get<bytecode::Instruction>();
+            }
+            chunk.constants.resize(count(1));
+            for (auto& constant : chunk.constants) {
+                constant = value();
+            }
+            chunk.names = strings();
+            chunk.globals = strings();
+            chunk.prototypes.resize(count(1));
+            for (auto& prototype : chunk.prototypes) {
+                auto result = std::make_shared<bytecode::Prototype>();
+                result->name = text();
+                result->parameters = strings();
+                result->chunk = this->chunk();
+                // Аргументы кладутся в первые регистры кадра
+                if (result->parameters.size() > result->chunk.registerCount) {
+                    throw std::runtime_error("Malformed function");
+                }
+                result->selfContained = get<bool>();
+                result->calls = strings();
+                prototype = std::move(result);
+            }
+            chunk.registerCount = get<uint16_t>();
+            validate(chunk);
+            return chunk;
+        }
+
+        /**
+         * @brief Reads an element count, checking that the data can hold that many elements.
+         */
+        size_t count(size_t minimumSize) {
+            auto count = get<uint32_t>();
+            if (count > (mData.size() - mPosition) / minimumSize) {
+                throw std::runtime_error("Truncated data");
+            }
+            return count;
+        }
+
+        bool atEnd() const { return mPosition == mData.size(); }
+
+    private:
+        std::string_view mData;
+        size_t mPosition = 0;
+
+        const char* bytes(size_t size) {
+            if (size > mData.size() - mPosition) {
+                throw std::runtime_error("Truncated data");
+            }
+            auto result = mData.data() + mPosition;
+            mPosition += size;
+            return result;
+        }
+    };
+}
+
+uint64_t maxlang::cache::hash(std::string_view source) {
+    // FNV-1a
+    uint64_t result = 14695981039346656037ull;
+    for (unsigned char c : source) {
+        result = (result ^ c) * 1099511628211ull;
+    }
+    return result;
+}
+
+uint64_t maxlang::cache::key(std::string_view source, const Library* library) {
+    auto result = hash(source);
+    return library ? (result ^ library->fingerprint()) * 1099511628211ull : result;
+}
+
+std::string maxlang::cache::save(const std::vector<bytecode::Chunk>& chunks, uint64_t sourceHash) {
+    Writer writer;
+    for (auto c : kMagic) {
+        writer.put(c);
+    }
+    writer.put(kFormatVersion);
+    writer.put(sourceHash);
+    writer.put(static_cast<uint32_t>(chunks.size()));
+    for (const auto& chunk : chunks) {
+        writer.put(chunk);
+    }
+    return writer.take();
+}
+
+std::optional<std::vector<bytecode::Chunk>> maxlang::cache::load(std::string_view data, uint64_t sourceHash) {
+    try {
+        Reader reader(data);
+        for (auto c : kMagic) {
+            if (reader.get<char>() != c) {
+                return std::nullopt;
+            }
+        }
+        if (reader.get<uint32_t>() != kFormatVersion || reader.get<uint64_t>() != sourceHash) {
+            return std::nullopt;
+        }
+        std::vector<bytecode::Chunk> chunks(reader.count(1));
+        for (auto& chunk : chunks) {
+            chunk = reader.chunk();
+        }
+        if (!reader.atEnd()) {
+            return std::nullopt;
+        }
+        return chunks;
+    } catch (const std::runtime_error&) {
+        return std::nullopt;
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "bytecode.h"
+#include "library.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @details
+ * Compiled programs stored on disk (`.mppc` files), so a script that has not changed since its
+ * last run skips lexing, parsing and compilation. A file holds the chunks of the top-level
+ * statements in execution order, together with the key of the source they were compiled from
+ * and the format version; it is ignored when either does not match.
+ */
+namespace maxlang::cache {
+    /**
+     * @brief Bumped on every change of the bytecode, the compiler or the file layout, and whenever
+     * a pure builtin starts returning different results: the key covers only which builtins are
+     * pure (Library::fingerprint), not what they compute, and their folded results are stored in
+     * the chunks.
+     */
+    inline constexpr uint32_t kFormatVersion = 3;
+
+    uint64_t hash(std::string_view source);
+
+    /**
+     * @brief Key of `source` compiled against `library` (nullptr when the context has none).
+     */
+    uint64_t key(std::string_view source, const Library* library);
+
+    /**
+     * @brief Serializes `chunks`; throws if a constant cannot be stored (arrays).
+     */
+    std::string save(const std::vector<bytecode::Chunk>& chunks, uint64_t sourceHash);
+
+    /**
+     * @brief Restores chunks saved for a source with `sourceHash`, or nullopt if `data` belongs to
+     * another source or version or is damaged.
+     */
+    std::optional<std::vector<bytecode::Chunk>> load(std::string_view data, uint64_t sourceHash);
+}
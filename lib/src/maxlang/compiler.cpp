@@ -0,0 +1,763 @@
+#include "compiler.h"
+#include "fmt/format.h"
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <optional>
+#include <set>
+#include <stdexcept>
+
+using namespace maxlang;
+using bytecode::Instruction;
+using bytecode::OpCode;
+
+namespace {
+    using Register = uint16_t;
+    using expression::Index;
+    using expression::kNone;
+
+    /**
+     * @brief Returns the name the node assigns, or kNone.
+     */
+    Index assignedName(const expression::Tree& tree, Index index) {
+        const auto& node = tree[index];
+        switch (node.kind) {
+            case expression::Kind::VariableAssignment:
+            case expression::Kind::VariableDeclaration:
+                return node.variable.name;
+            case expression::Kind::ForEach:
+                return node.forEach.variable;
+            case expression::Kind::CompoundAssignment: {
+                const auto& target = tree[node.compound.target];
+                return target.kind == expression::Kind::VariableReference ? target.variable.name : kNone;
+            }
+            case expression::Kind::PostfixIncrement:
+            case expression::Kind::PostfixDecrement: {
+                const auto& operand = tree[node.operand];
+                if (operand.kind == expression::Kind::VariableReference) {
+                    return operand.variable.name;
+                }
+                return kNone;
+            }
+            default:
+                return kNone;
+        }
+    }
+
+    /**
+     * @brief Calls `f` with every variable name the node assigns, not looking into nested functions.
+     */
+    template <typename F>
+    void forEachAssigned(const expression::Tree& tree, Index index, F&& f) {
+        if (auto name = assignedName(tree, index); name != kNone) {
+            f(tree.name(name));
+        }
+        if (tree[index].kind == expression::Kind::FunctionDeclaration) {
+            return;
+        }
+        expression::forEachChild(tree, index, [&](Index child) {
+            forEachAssigned(tree, child, f);
+        });
+    }
+
+    bool assigns(const expression::Tree& tree, Index index, std::string_view name) {
+        bool result = false;
+        forEachAssigned(tree, index, [&](std::string_view assigned) { result = result || assigned == name; });
+        return result;
+    }
+
+    /**
+     * @brief Fills the facts purity analysis needs (see bytecode::Prototype::calls).
+     */
+    void analyze(const expression::Tree& tree, Index index, bytecode::Prototype& prototype) {
+        const auto& node = tree[index];
+        switch (node.kind) {
+            case expression::Kind::FunctionCall: {
+                auto name = tree.name(node.call.name);
+                if (std::ranges::find(prototype.calls, name) == prototype.calls.end()) {
+                    prototype.calls.emplace_back(name);
+                }
+                break;
+            }
+            case expression::Kind::FunctionDeclaration:
+            case expression::Kind::ArrayCreation:
+            case expression::Kind::ArrayIndex:
+            case expression::Kind::ArrayAssignment:
+            case expression::Kind::ForEach:
+                prototype.selfContained = false;
+                return;
+            default:
+                break;
+        }
+        expression::forEachChild(tree, index, [&](Index child) {
+            analyze(tree, child, prototype);
+        });
+    }
+
+    class ChunkBuilder {
+    public:
+        /**
+         * @brief Builder for top-level code. Expression statements leave their value in a
+         * completion register that is returned at the end of the chunk.
+         */
+        explicit ChunkBuilder(const expression::Tree& tree) : mTree(tree), mTopLevel(true) {
+            mCompletion = allocate();
+        }
+
+        /**
+         * @brief Builder for a function body: parameters take the first registers, followed
+         * by every other variable the body assigns.
+         */
+        ChunkBuilder(const expression::Tree& tree, expression::List parameters, expression::CommandSequence body)
+          : mTree(tree), mTopLevel(false) {
+            for (auto parameter : tree[parameters]) {
+                if (!mLocals.contains(tree.name(parameter))) {
+                    mLocals.emplace(tree.name(parameter), allocate());
+                } else {
+                    // Повторяющийся параметр всё равно занимает свой регистр
+                    allocate();
+                }
+            }
+            for (auto command : tree[body]) {
+                forEachAssigned(tree, command, [&](std::string_view name) {
+                    if (!mLocals.contains(name)) {
+                        mLocals.emplace(name, allocate());
+                    }
+                });
+            }
+
+            std::set<std::string_view> assigned;
+            for (auto parameter : tree[parameters]) {
+                assigned.insert(tree.name(parameter));
+            }
+            for (auto command : tree[body]) {
+                findUnassignedReads(command, assigned);
+            }
+        }
+
+        bytecode::Chunk finish() {
+            emitReturnVoid();
+            return std::move(mChunk);
+        }
+
+        void sequence(expression::CommandSequence commands) {
+            for (auto command : mTree[commands]) {
+                statement(command);
+            }
+        }
+
+        void statement(Index index) {
+            using expression::Kind;
+
+            const auto& node = mTree[index];
+            auto mark = mTop;
+            switch (node.kind) {
+                case Kind::If: {
+                    auto skip = condition(node.branch.condition);
+                    sequence(node.branch.body);
+                    patch(skip);
+                    break;
+                }
+                case Kind::IfElse: {
+                    auto otherwise = condition(node.branch.condition);
+                    sequence(node.branch.body);
+                    auto end = emitJump(OpCode::Jump);
+                    patch(otherwise);
+                    sequence(node.branch.elseBody);
+                    patch(end);
+                    break;
+                }
+                case Kind::While: {
+                    auto start = here();
+                    auto exit = condition(node.branch.condition);
+                    loop(node.branch.body);
+                    jumpTo(start);
+                    patch(exit);
+                    closeLoop(start);
+                    break;
+                }
+                case Kind::For: {
+                    auto& n = node.loop;
+                    if (n.initialization != kNone) {
+                        statement(n.initialization);
+                    }
+                    auto start = here();
+                    std::optional<size_t> exit;
+                    if (n.condition != kNone) {
+                        exit = condition(n.condition);
+                    }
+                    loop(n.body);
+                    auto next = here();
+                    if (n.increment != kNone) {
+                        statement(n.increment);
+                    }
+                    jumpTo(start);
+                    if (exit) {
+                        patch(*exit);
+                    }
+                    closeLoop(next);
+                    break;
+                }
+                case Kind::ForEach: {
+                    auto& n = node.forEach;
+                    auto variable = mTree.name(n.variable);
+                    auto array = allocate();
+                    auto index = allocate();
+                    auto local = this->local(variable);
+                    auto element = local ? *local : allocate();
+                    expression(n.collection, array);
+                    emit(OpCode::LoadConstant, index, constant(0));
+                    auto start = here();
+                    emit(OpCode::IterNext, array, index, element);
+                    auto exit = emitJump(OpCode::Jump);
+                    if (!local) {
+                        store(variable, element);
+                    } else {
+                        markAssigned(variable);
+                    }
+                    loop(n.body);
+                    jumpTo(start);
+                    patch(exit);
+                    closeLoop(start);
+                    break;
+                }
+                case Kind::Break:
+                    if (mLoops.empty()) {
+                        // break outside of a loop stops the current command sequence
+                        emitReturnVoid();
+                    } else {
+                        mLoops.back().breaks.push_back(emitJump(OpCode::Jump));
+                    }
+                    break;
+                case Kind::Continue:
+                    if (!mLoops.empty()) {
+                        mLoops.back().continues.push_back(emitJump(OpCode::Jump));
+                    }
+                    break;
+                case Kind::Return: {
+                    auto value = node.operand;
+                    if (value != kNone && mTree[value].kind == Kind::FunctionCall && !mTopLevel) {
+                        // Хвостовой вызов: VM переиспользует кадр, Return нужен для встроенных функций
+                        auto& call = mTree[value].call;
+                        auto base = consecutive(call.args);
+                        emit(OpCode::TailCall, base, name(mTree.name(call.name)), checked(call.args.size, "arguments"));
+                        emit(OpCode::Return, base);
+                    } else if (value != kNone) {
+                        emit(OpCode::Return, operand(value));
+                    } else {
+                        emit(OpCode::ReturnVoid);
+                    }
+                    break;
+                }
+                case Kind::FunctionDeclaration: {
+                    auto& n = node.function;
+                    ChunkBuilder body(mTree, n.parameters, n.body);
+                    body.sequence(n.body);
+
+                    auto prototype = std::make_shared<bytecode::Prototype>();
+                    prototype->name = mTree.name(n.name);
+                    for (auto parameter : mTree[n.parameters]) {
+                        prototype->parameters.emplace_back(mTree.name(parameter));
+                    }
+                    prototype->chunk = body.finish();
+                    for (auto command : mTree[n.body]) {
+                        analyze(mTree, command, *prototype);
+                    }
+
+                    mChunk.prototypes.push_back(std::move(prototype));
+                    emit(OpCode::DefineFunction, checked(mChunk.prototypes.size() - 1, "functions"));
+                    break;
+                }
+                case Kind::VariableAssignment:
+                case Kind::VariableDeclaration:
+                    if (mCompletion) {
+                        expression(index, *mCompletion);
+                    } else {
+                        assignment(index, std::nullopt);
+                    }
+                    break;
+                case Kind::CompoundAssignment:
+                    if (mCompletion) {
+                        expression(index, *mCompletion);
+                    } else {
+                        compound(index, std::nullopt);
+                    }
+                    break;
+                case Kind::PostfixIncrement:
+                case Kind::PostfixDecrement:
+                    if (auto name = assignedName(mTree, index); name != kNone && !mCompletion && local(mTree.name(name))) {
+                        // Значение выражения не нужно: изменяем регистр на месте
+                        auto reg = read(mTree.name(name));
+                        emit(node.kind == Kind::PostfixIncrement ? OpCode::Increment : OpCode::Decrement, reg, reg);
+                        break;
+                    }
+                    expression(index, mCompletion ? *mCompletion : allocate());
+                    break;
+                default:
+                    expression(index, mCompletion ? *mCompletion : allocate());
+                    break;
+            }
+            mTop = mark;
+        }
+
+        /**
+         * @brief Compiles an expression so that its value ends up in `target`.
+         */
+        void expression(Index index, Register target) {
+            using expression::Kind;
+
+            const auto& node = mTree[index];
+            auto mark = mTop;
+            switch (node.kind) {
+                case Kind::Constant:
+                    emit(OpCode::LoadConstant, target, constant(mTree.constant(node.operand)));
+                    break;
+                case Kind::Add:
+                case Kind::Subtract:
+                case Kind::Multiply:
+                case Kind::Divide:
+                case Kind::Equal:
+                case Kind::NotEqual:
+                case Kind::Less:
+                case Kind::Greater:
+                case Kind::LessEqual:
+                case Kind::GreaterEqual: {
+                    auto& n = node.binary;
+                    // Регистр переменной слева можно читать напрямую, только если правая часть не может её изменить
+                    auto lhs = isLocalReference(n.lhs) && !assignsAnyLocal(n.rhs) ? operand(n.lhs) : temporary(n.lhs);
+                    auto rhs = operand(n.rhs);
+                    emit(binaryOp(node.kind), target, lhs, rhs);
+                    break;
+                }
+                case Kind::VariableReference:
+                    load(mTree.name(node.variable.name), target);
+                    break;
+                case Kind::VariableAssignment:
+                case Kind::VariableDeclaration:
+                    assignment(index, target);
+                    break;
+                case Kind::CompoundAssignment:
+                    compound(index, target);
+                    break;
+                case Kind::FunctionCall: {
+                    auto& n = node.call;
+                    auto base = consecutive(n.args);
+                    emit(OpCode::Call, base, name(mTree.name(n.name)), checked(n.args.size, "arguments"));
+                    move(target, base);
+                    break;
+                }
+                case Kind::ArrayCreation: {
+                    auto base = consecutive(node.elements);
+                    emit(OpCode::NewArray, target, base, checked(node.elements.size, "array elements"));
+                    break;
+                }
+                case Kind::ArrayIndex: {
+                    auto& n = node.element;
+                    auto array = assignsAnyLocal(n.index) ? temporary(n.array) : operand(n.array);
+                    auto index = operand(n.index);
+                    emit(OpCode::GetIndex, target, array, index);
+                    break;
+                }
+                case Kind::ArrayAssignment: {
+                    auto& n = node.element;
+                    auto array = temporary(n.array);
+                    auto index = temporary(n.index);
+                    expression(n.value, target);
+                    emit(OpCode::SetIndex, array, index, target);
+                    break;
+                }
+                case Kind::PostfixIncrement:
+                case Kind::PostfixDecrement: {
+                    auto& operand = mTree[node.operand];
+                    auto op = node.kind == Kind::PostfixIncrement ? OpCode::Increment : OpCode::Decrement;
+                    auto updated = allocate();
+
+                    if (operand.kind == Kind::VariableReference) {
+                        auto variable = mTree.name(operand.variable.name);
+                        load(variable, target);
+                        emit(op, updated, target);
+                        store(variable, updated);
+                    } else if (operand.kind == Kind::ArrayIndex) {
+                        auto array = temporary(operand.element.array);
+                        auto index = temporary(operand.element.index);
+                        emit(OpCode::GetIndex, target, array, index);
+                        emit(op, updated, target);
+                        emit(OpCode::SetIndex, array, index, updated);
+                    } else {
+                        throw std::runtime_error("Postfix increment can only be applied to variables or array elements");
+                    }
+                    break;
+                }
+                default:
+                    // Statements used as expressions evaluate to void
+                    statement(index);
+                    emit(OpCode::LoadConstant, target, constant(std::monostate {}));
+                    break;
+            }
+            mTop = mark;
+        }
+
+    private:
+        struct Loop {
+            std::vector<size_t> breaks;
+            std::vector<size_t> continues;
+        };
+
+        const expression::Tree& mTree;
+        bytecode::Chunk mChunk;
+        std::vector<Loop> mLoops;
+        std::map<std::string, uint16_t, std::less<>> mNames;
+        std::map<std::string, uint16_t, std::less<>> mGlobals;
+        std::map<std::string, Register, std::less<>> mLocals;
+        // Флаги локальных переменных, которые могут читаться до присваивания
+        std::map<std::string, Register, std::less<>> mFlags;
+        std::optional<Register> mCompletion;
+        const bool mTopLevel;
+        Register mTop = 0;
+
+        static uint16_t checked(size_t value, const char* what) {
+            if (value > std::numeric_limits<uint16_t>::max()) {
+                throw std::runtime_error(fmt::format("Too many {} in one function", what));
+            }
+            return static_cast<uint16_t>(value);
+        }
+
+        static OpCode binaryOp(expression::Kind kind) {
+            switch (kind) {
+                case expression::Kind::Add: return OpCode::Add;
+                case expression::Kind::Subtract: return OpCode::Subtract;
+                case expression::Kind::Multiply: return OpCode::Multiply;
+                case expression::Kind::Divide: return OpCode::Divide;
+                case expression::Kind::Equal: return OpCode::Equal;
+                case expression::Kind::NotEqual: return OpCode::NotEqual;
+                case expression::Kind::Less: return OpCode::Less;
+                case expression::Kind::Greater: return OpCode::Greater;
+                case expression::Kind::LessEqual: return OpCode::LessEqual;
+                case expression::Kind::GreaterEqual: return OpCode::GreaterEqual;
+                default: throw std::runtime_error("Internal error: not a binary operator");
+            }
+        }
+
+        Register allocate() {
+            auto reg = checked(mTop, "registers");
+            ++mTop;
+            mChunk.registerCount = std::max(mChunk.registerCount, checked(mTop, "registers"));
+            return reg;
+        }
+
+        std::optional<Register> local(std::string_view name) const {
+            if (auto it = mLocals.find(name); it != mLocals.end()) {
+                return it->second;
+            }
+            return std::nullopt;
+        }
+
+        /**
+         * @brief Returns the register of a local variable that is about to be read. A variable
+         * that may not be assigned yet is checked first, so the read fails as it does for globals.
+         */
+        Register read(std::string_view variable) {
+            if (auto it = mFlags.find(variable); it != mFlags.end()) {
+                emit(OpCode::CheckDefined, it->second, name(variable));
+            }
+            return *local(variable);
+        }
+
+        /**
+         * @brief Records that a checked local variable (see read) received a value.
+         */
+        void markAssigned(std::string_view variable) {
+            if (auto it = mFlags.find(variable); it != mFlags.end()) {
+                emit(OpCode::LoadConstant, it->second, constant(1));
+            }
+        }
+
+        /**
+         * @brief Finds the locals that some path reads before assigning them (`y = x; x = 1;`)
+         * and gives each a flag register, which is void until the variable is assigned.
+         * `assigned` holds the locals assigned on every path to the node.
+         */
+        void findUnassignedReads(Index index, std::set<std::string_view>& assigned) {
+            using expression::Kind;
+
+            const auto& node = mTree[index];
+            auto branch = [&](expression::List body, std::set<std::string_view> inner) {
+                for (auto command : mTree[body]) {
+                    findUnassignedReads(command, inner);
+                }
+                return inner;
+            };
+            auto visit = [&](Index child) {
+                if (child != kNone) {
+                    findUnassignedReads(child, assigned);
+                }
+            };
+            switch (node.kind) {
+                case Kind::VariableReference: {
+                    auto variable = mTree.name(node.variable.name);
+                    if (local(variable) && !assigned.contains(variable) && !mFlags.contains(variable)) {
+                        mFlags.emplace(variable, allocate());
+                    }
+                    return;
+                }
+                case Kind::VariableAssignment:
+                case Kind::VariableDeclaration:
+                    visit(node.variable.value);
+                    assigned.insert(mTree.name(node.variable.name));
+                    return;
+                case Kind::If:
+                    visit(node.branch.condition);
+                    branch(node.branch.body, assigned);
+                    return;
+                case Kind::IfElse: {
+                    visit(node.branch.condition);
+                    auto then = branch(node.branch.body, assigned);
+                    auto otherwise = branch(node.branch.elseBody, assigned);
+                    std::erase_if(then, [&](std::string_view variable) { return !otherwise.contains(variable); });
+                    assigned = std::move(then);
+                    return;
+                }
+                case Kind::While:
+                    visit(node.branch.condition);
+                    branch(node.branch.body, assigned);
+                    return;
+                case Kind::For: {
+                    visit(node.loop.initialization);
+                    visit(node.loop.condition);
+                    branch(node.loop.body, assigned);
+                    // continue переходит к приращению, минуя остаток тела
+                    if (node.loop.increment != kNone) {
+                        auto increment = assigned;
+                        findUnassignedReads(node.loop.increment, increment);
+                    }
+                    return;
+                }
+                case Kind::ForEach: {
+                    visit(node.forEach.collection);
+                    auto inner = assigned;
+                    inner.insert(mTree.name(node.forEach.variable));
+                    branch(node.forEach.body, std::move(inner));
+                    return;
+                }
+                case Kind::FunctionDeclaration:
+                    return;
+                default:
+                    // Составное присваивание и инкремент сначала читают переменную
+                    expression::forEachChild(mTree, index, [&](Index child) { findUnassignedReads(child, assigned); });
+                    if (auto name = assignedName(mTree, index); name != kNone) {
+                        assigned.insert(mTree.name(name));
+                    }
+                    return;
+            }
+        }
+
+        bool isLocalReference(Index index) const {
+            const auto& node = mTree[index];
+            return node.kind == expression::Kind::VariableReference && local(mTree.name(node.variable.name));
+        }
+
+        bool assignsAnyLocal(Index index) const {
+            bool result = false;
+            forEachAssigned(mTree, index, [&](std::string_view name) { result = result || local(name); });
+            return result;
+        }
+
+        /**
+         * @brief Returns a register holding the value of the expression: the register of a local
+         * variable is used as is, anything else is evaluated into a temporary.
+         */
+        Register operand(Index index) {
+            if (isLocalReference(index)) {
+                return read(mTree.name(mTree[index].variable.name));
+            }
+            return temporary(index);
+        }
+
+        Register temporary(Index index) {
+            auto reg = allocate();
+            expression(index, reg);
+            return reg;
+        }
+
+        void load(std::string_view variable, Register target) {
+            if (mTopLevel) {
+                emit(OpCode::LoadGlobal, target, global(variable));
+            } else if (local(variable)) {
+                move(target, read(variable));
+            } else {
+                // Функция видит только свои параметры и локальные переменные
+                emit(OpCode::Undefined, target, name(variable));
+            }
+        }
+
+        void store(std::string_view variable, Register source) {
+            if (mTopLevel) {
+                emit(OpCode::StoreGlobal, source, global(variable));
+            } else {
+                move(*local(variable), source);
+            }
+        }
+
+        /**
+         * @brief Compiles `name = value`. A local variable receives the value directly unless the
+         * value expression assigns the same variable itself.
+         */
+        void assignment(Index index, std::optional<Register> target) {
+            auto variable = mTree.name(mTree[index].variable.name);
+            auto value = mTree[index].variable.value;
+
+            auto reg = local(variable);
+            Register destination = reg && (value == kNone || !assigns(mTree, value, variable)) ? *reg
+                : target ? *target : allocate();
+            if (value != kNone) {
+                expression(value, destination);
+            } else {
+                emit(OpCode::LoadConstant, destination, constant(std::monostate {}));
+            }
+            if (!reg || destination != *reg) {
+                store(variable, destination);
+            }
+            if (reg) {
+                markAssigned(variable);
+            }
+            if (target) {
+                move(*target, destination);
+            }
+        }
+
+        /**
+         * @brief Compiles `target op= value`. The storage of the target is resolved once: a local
+         * variable is updated in its register, an array element is read and written through the
+         * same array and index registers.
+         */
+        void compound(Index index, std::optional<Register> target) {
+            const auto& n = mTree[index].compound;
+            const auto& lvalue = mTree[n.target];
+            auto op = binaryOp(n.op);
+
+            Register result;
+            if (lvalue.kind == expression::Kind::VariableReference) {
+                auto variable = mTree.name(lvalue.variable.name);
+                auto reg = local(variable);
+                if (reg && !assignsAnyLocal(n.value)) {
+                    read(variable);
+                    emit(op, *reg, *reg, operand(n.value));
+                    result = *reg;
+                } else {
+                    // Значение читается до вычисления правой части, как в `x = x + value`
+                    result = allocate();
+                    load(variable, result);
+                    emit(op, result, result, operand(n.value));
+                    store(variable, result);
+                }
+            } else {
+                bool clobbers = assignsAnyLocal(lvalue.element.index) || assignsAnyLocal(n.value);
+                auto array = clobbers ? temporary(lvalue.element.array) : operand(lvalue.element.array);
+                auto element = clobbers ? temporary(lvalue.element.index) : operand(lvalue.element.index);
+                result = allocate();
+                emit(OpCode::GetIndex, result, array, element);
+                emit(op, result, result, operand(n.value));
+                emit(OpCode::SetIndex, array, element, result);
+            }
+            if (target) {
+                move(*target, result);
+            }
+        }
+
+        /**
+         * @brief Evaluates expressions into consecutive registers and returns the first one.
+         * At least one register is reserved so that it can hold a result.
+         */
+        Register consecutive(expression::List list) {
+            auto expressions = mTree[list];
+            auto base = mTop;
+            for (size_t i = 0; i < std::max<size_t>(expressions.size(), 1); ++i) {
+                allocate();
+            }
+            for (size_t i = 0; i < expressions.size(); ++i) {
+                expression(expressions[i], static_cast<Register>(base + i));
+            }
+            return base;
+        }
+
+        uint16_t constant(Value value) {
+            for (size_t i = 0; i < mChunk.constants.size(); ++i) {
+                if (mChunk.constants[i].index() == value.index() && mChunk.constants[i] == value) {
+                    return static_cast<uint16_t>(i);
+                }
+            }
+            mChunk.constants.push_back(std::move(value));
+            return checked(mChunk.constants.size() - 1, "constants");
+        }
+
+        static uint16_t intern(std::map<std::string, uint16_t, std::less<>>& index, std::vector<std::string>& table,
+            std::string_view name, const char* what) {
+            if (auto it = index.find(name); it != index.end()) {
+                return it->second;
+            }
+            table.emplace_back(name);
+            auto slot = checked(table.size() - 1, what);
+            index.emplace(name, slot);
+            return slot;
+        }
+
+        uint16_t name(std::string_view name) { return intern(mNames, mChunk.names, name, "names"); }
+
+        uint16_t global(std::string_view name) { return intern(mGlobals, mChunk.globals, name, "globals"); }
+
+        size_t here() const { return mChunk.code.size(); }
+
+        size_t emit(OpCode op, uint16_t a = 0, uint16_t b = 0, uint16_t c = 0) {
+            mChunk.code.push_back(Instruction { .op = op, .a = a, .b = b, .c = c });
+            return mChunk.code.size() - 1;
+        }
+
+        void move(Register target, Register source) {
+            if (target != source) {
+                emit(OpCode::Move, target, source);
+            }
+        }
+
+        size_t emitJump(OpCode op, Register condition = 0) { return emit(op, condition); }
+
+        void jumpTo(size_t target) { mChunk.code[emitJump(OpCode::Jump)].setTarget(static_cast<uint32_t>(target)); }
+
+        void patch(size_t jump) { mChunk.code[jump].setTarget(static_cast<uint32_t>(here())); }
+
+        void emitReturnVoid() {
+            if (mCompletion) {
+                emit(OpCode::Return, *mCompletion);
+            } else {
+                emit(OpCode::ReturnVoid);
+            }
+        }
+
+        /**
+         * @brief Evaluates a condition and emits a jump taken when it is false.
+         */
+        size_t condition(Index index) {
+            return emitJump(OpCode::JumpIfFalse, operand(index));
+        }
+
+        void loop(expression::CommandSequence body) {
+            mLoops.emplace_back();
+            sequence(body);
+        }
+
+        void closeLoop(size_t continueTarget) {
+            for (auto jump : mLoops.back().continues) {
+                mChunk.code[jump].setTarget(static_cast<uint32_t>(continueTarget));
+            }
+            for (auto jump : mLoops.back().breaks) {
+                patch(jump);
+            }
+            mLoops.pop_back();
+        }
+    };
+}   // namespace
+
+bytecode::Chunk maxlang::compiler::compile(const expression::Tree& tree, expression::CommandSequence commands) {
+    ChunkBuilder builder(tree);
+    builder.sequence(commands);
+    return builder.finish();
+}
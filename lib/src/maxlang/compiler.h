@@ -0,0 +1,32 @@
+#pragma once
+
+#include "bytecode.h"
+#include "expression.h"
+
+/**
+ * @details
+ * Compiler turns the AST built by Parser into bytecode for the VM. For example:
+ *
+ * ```
+ * a = 1 + 2;
+ * ```
+ *
+ * Will be compiled into:
+ * ```
+ * LoadConstant  1 0      // R1 = 1
+ * LoadConstant  2 1      // R2 = 2
+ * Add           0 1 2    // R0 = R1 + R2
+ * StoreGlobal   0 0      // a = R0
+ * Return        0
+ * ```
+ *
+ * Variables are resolved at compile time: top-level code addresses global slots, while
+ * parameters and variables assigned inside a function get registers of its frame.
+ */
+namespace maxlang::compiler {
+    /**
+     * @brief Compiles a top-level command sequence. The chunk returns the value of the last
+     * expression statement it evaluated (or the value of an explicit `return`).
+     */
+    bytecode::Chunk compile(const expression::Tree& tree, expression::CommandSequence commands);
+}
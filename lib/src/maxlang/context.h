@@ -3,30 +3,28 @@
 #include <map>
 #include <string>
 #include <memory>
-#include "value.h"
-#include "function.h" // Перенесите include сюда
 #include <optional>
+#include "array.h"
+#include "value.h"
+#include "functions.h"
+#include "memo.h"
+#include "variables.h"
 
 namespace maxlang {
-    struct Array; // Предварительное объявление
-
     struct Context {
-        std::map<std::string, Function> functions;
-        std::map<std::string, Value> variables;
-        std::map<std::string, std::shared_ptr<Array>> arrays;
-        std::optional<Value> returnValue;
-        bool shouldReturn = false;
-        bool shouldBreak = false;
-        bool shouldContinue = false;
-
-        void resetReturn() {
-            shouldReturn = false;
-            returnValue = std::monostate{};
-        }
+        Functions functions;
+        Variables variables;
+        // Учёт массивов контекста: число живых, занятая память, сборка циклов.
+        // Создаётся вместе с первым массивом (см. heap())
+        std::shared_ptr<ArrayHeap> arrays;
+        // Запоминание результатов чистых функций, выключено, пока не создано
+        std::optional<Memo> memo;
 
-        void resetLoopControls() {
-            shouldBreak = false;
-            shouldContinue = false;
+        ArrayHeap& heap() {
+            if (!arrays) {
+                arrays = std::make_shared<ArrayHeap>();
+            }
+            return *arrays;
         }
     };
-}
\ No newline at end of file
+}
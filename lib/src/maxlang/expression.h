@@ -1,669 +1,343 @@
 #pragma once
 
-#include <utility>
-#include <memory>
-#include <map>
+#include <cstdint>
 #include <functional>
-#include "array.h"
+#include <limits>
+#include <span>
 #include <stdexcept>
-#include "context.h"
-#include "fmt/format.h"
-#include "util.h"
-
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "arena.h"
+#include "value.h"
+
+/**
+ * @details
+ * AST produced by the Parser. Nodes are plain data: they are not evaluated directly,
+ * but compiled into bytecode (see compiler.h) and executed by the VM (see vm.h).
+ *
+ * The whole tree is stored in a Tree: nodes lie in one vector and refer to their children,
+ * constants and names by 32-bit indices, and child lists are ranges of another vector.
+ * Passes walk it with a switch on Node::kind.
+ */
 namespace maxlang::expression {
-    struct ArrayIndex;
-    struct ArrayCreation;
-    struct While;
-
-    struct Base {
-        virtual ~Base() = default;
-
-        virtual Value evaluate(Context& context) = 0;
+    enum class Kind : uint8_t {
+        Constant,
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+        Equal,
+        NotEqual,
+        Less,
+        Greater,
+        LessEqual,
+        GreaterEqual,
+        VariableAssignment,
+        VariableDeclaration,
+        VariableReference,
+        FunctionCall,
+        FunctionDeclaration,
+        If,
+        IfElse,
+        Return,
+        While,
+        For,
+        ForEach,
+        Break,
+        Continue,
+        ArrayCreation,
+        ArrayIndex,
+        ArrayAssignment,
+        PostfixIncrement,
+        PostfixDecrement,
+        CompoundAssignment,
     };
 
-    using CommandSequence = std::vector<std::unique_ptr<maxlang::expression::Base>>;
+    using Index = uint32_t;
 
-    void execute(const CommandSequence& commands, Context& context);
+    /**
+     * @brief Marks an absent optional child (e.g. the condition of `for (;;)`).
+     */
+    inline constexpr Index kNone = std::numeric_limits<Index>::max();
 
-    struct Constant : Base {
-        explicit Constant(Value value) : value(std::move(value)) {}
-        ~Constant() override = default;
-
-        Value value;
-        Value evaluate(Context& context) override { return value; }
+    /**
+     * @brief Range of Tree::lists holding node indices (or name indices for parameters).
+     */
+    struct List {
+        Index begin;
+        Index size;
     };
 
-    template <typename Op>
-    struct Binary : Base {
-        Binary(std::unique_ptr<expression::Base> lhs, std::unique_ptr<expression::Base> rhs)
-          : lhs(std::move(lhs)), rhs(std::move(rhs)) {}
-        ~Binary() override = default;
-
-        std::unique_ptr<expression::Base> lhs;
-        std::unique_ptr<expression::Base> rhs;
-
-        Value evaluate(Context& context) override {
-            return std::visit(
-                maxlang::match {
-                  [](auto&& lhs_val, auto&& rhs_val) -> Value {
-                      if constexpr (requires { Op{}(lhs_val, rhs_val); }) {
-                          return Op{}(lhs_val, rhs_val);
-                      }
-                      throw std::runtime_error(fmt::format("Can't perform operation on {} and {}",
-                          typeid(lhs_val).name(), typeid(rhs_val).name()));
-                  },
-                },
-                lhs->evaluate(context), rhs->evaluate(context));
-        }
-    };
-
-    // Специализация для оператора равенства ==
-    template <>
-    struct Binary<std::equal_to<>> : Base {
-        Binary(std::unique_ptr<expression::Base> lhs, std::unique_ptr<expression::Base> rhs)
-          : lhs(std::move(lhs)), rhs(std::move(rhs)) {}
-        ~Binary() override = default;
-
-        std::unique_ptr<expression::Base> lhs;
-        std::unique_ptr<expression::Base> rhs;
+    using CommandSequence = List;
 
-        Value evaluate(Context& context) override {
-            auto lhs_val = lhs->evaluate(context);
-            auto rhs_val = rhs->evaluate(context);
-
-            // Специальная обработка для сравнения массивов
-            if (std::holds_alternative<std::string>(lhs_val) && std::holds_alternative<std::string>(rhs_val)) {
-                std::string lhs_name = std::get<std::string>(lhs_val);
-                std::string rhs_name = std::get<std::string>(rhs_val);
-
-                auto lhs_it = context.arrays.find(lhs_name);
-                auto rhs_it = context.arrays.find(rhs_name);
-
-                if (lhs_it != context.arrays.end() && rhs_it != context.arrays.end()) {
-                    return *(lhs_it->second) == *(rhs_it->second) ? 1 : 0;
-                }
-            }
-
-            // Стандартная логика для других типов
-            return std::visit(
-                maxlang::match {
-                  [](auto&& l, auto&& r) -> Value {
-                      return (l == r) ? 1 : 0;
-                  },
-                },
-                lhs_val, rhs_val);
-        }
+    struct Binary {
+        Index lhs;
+        Index rhs;
     };
 
-    // Специализация для оператора неравенства !=
-    template <>
-    struct Binary<std::not_equal_to<>> : Base {
-        Binary(std::unique_ptr<expression::Base> lhs, std::unique_ptr<expression::Base> rhs)
-          : lhs(std::move(lhs)), rhs(std::move(rhs)) {}
-        ~Binary() override = default;
-
-        std::unique_ptr<expression::Base> lhs;
-        std::unique_ptr<expression::Base> rhs;
-
-        Value evaluate(Context& context) override {
-            auto lhs_val = lhs->evaluate(context);
-            auto rhs_val = rhs->evaluate(context);
-
-            // Специальная обработка для сравнения массивов
-            if (std::holds_alternative<std::string>(lhs_val) && std::holds_alternative<std::string>(rhs_val)) {
-                std::string lhs_name = std::get<std::string>(lhs_val);
-                std::string rhs_name = std::get<std::string>(rhs_val);
-
-                auto lhs_it = context.arrays.find(lhs_name);
-                auto rhs_it = context.arrays.find(rhs_name);
-
-                if (lhs_it != context.arrays.end() && rhs_it != context.arrays.end()) {
-                    return *(lhs_it->second) != *(rhs_it->second) ? 1 : 0;
-                }
-            }
-
-            // Стандартная логика для других типов
-            return std::visit(
-                maxlang::match {
-                  [](auto&& l, auto&& r) -> Value {
-                      return (l != r) ? 1 : 0;
-                  },
-                },
-                lhs_val, rhs_val);
-        }
+    struct Variable {
+        Index name;
+        Index value;    // kNone for references and declarations without a value
     };
 
-    struct VariableAssignment : Base {
-        VariableAssignment(std::string name, std::unique_ptr<expression::Base> value)
-          : name(std::move(name)), value(std::move(value)) {}
-        ~VariableAssignment() override = default;
-        std::string name;
-        std::unique_ptr<expression::Base> value;
-
-        Value evaluate(Context& context) override { return context.variables[name] = value->evaluate(context); }
+    struct Call {
+        Index name;
+        List args;
     };
 
-    struct FunctionCall : Base {
-        FunctionCall(std::string name, std::vector<std::unique_ptr<expression::Base>> args)
-          : name(std::move(name)), args(std::move(args)) {}
-        ~FunctionCall() override = default;
-        std::string name;
-        std::vector<std::unique_ptr<expression::Base>> args;
-
-        Value evaluate(Context& context) override;
+    struct Function {
+        Index name;
+        List parameters;
+        List body;
     };
 
-    struct VariableReference : Base {
-        explicit VariableReference(std::string name) : name(std::move(name)) {}
-        ~VariableReference() override = default;
-        std::string name;
-        Value evaluate(Context& context) override {
-            auto it = context.variables.find(name);
-            if (it == context.variables.end()) {
-                throw std::runtime_error("Variable not found: " + name);
-            }
-            return it->second;
-        }
+    struct Branch {
+        Index condition;
+        List body;
+        List elseBody;  // only for IfElse
     };
 
-    struct If : Base {
-        If(std::unique_ptr<expression::Base> condition, CommandSequence body)
-          : condition(std::move(condition)), body(std::move(body)) {}
-        ~If() override = default;
-
-        std::unique_ptr<expression::Base> condition;
-        CommandSequence body;
-
-        Value evaluate(Context& context) override {
-            if (getIntFromValue(condition->evaluate(context), "if condition") != 0) {
-                expression::execute(body, context);
-            }
-            return std::monostate {};
-        }
+    struct Loop {
+        Index initialization;
+        Index condition;
+        Index increment;
+        List body;
     };
 
-    struct Return : Base {
-        explicit Return(std::unique_ptr<expression::Base> expression) : expression(std::move(expression)) {}
-        ~Return() override = default;
-
-        std::unique_ptr<expression::Base> expression;
-
-        Value evaluate(Context& context) override {
-            context.returnValue = expression != nullptr ? expression->evaluate(context) : std::monostate {};
-            context.shouldReturn = true;
-            return std::monostate {};
-        }
+    struct ForEach {
+        Index variable;
+        Index collection;
+        List body;
     };
 
-    struct While : maxlang::expression::Base {
-        While(std::unique_ptr<Base> condition, maxlang::expression::CommandSequence body)
-          : condition(std::move(condition)), body(std::move(body)) {}
-        ~While() override = default;
-
-        std::unique_ptr<Base> condition;
-        maxlang::expression::CommandSequence body;
-
-        Value evaluate(Context& context) override {
-            context.resetLoopControls();
-
-            while (true) {
-                // Проверяем break ДО условия
-                if (context.shouldBreak) break;
-
-                // Проверяем continue - пропускаем проверку условия и тело
-                if (context.shouldContinue) {
-                    context.shouldContinue = false;
-                    continue; // Переходим к следующей итерации
-                }
-
-                Value condValue = condition->evaluate(context);
-                if (getIntFromValue(condValue, "условии while") == 0) {
-                    break;
-                }
-
-                execute(body, context);
-
-                if (context.shouldReturn) break;
-                if (context.shouldBreak) break;
-            }
-
-            context.resetLoopControls();
-            return std::monostate{};
-        }
+    struct Element {
+        Index array;
+        Index index;
+        Index value;    // only for ArrayAssignment
     };
-    struct For : Base {
-        For(std::unique_ptr<Base> initialization,
-            std::unique_ptr<Base> condition,
-            std::unique_ptr<Base> increment,
-            CommandSequence body)
-            : initialization(std::move(initialization)),
-              condition(std::move(condition)),
-              increment(std::move(increment)),
-              body(std::move(body)) {}
-        ~For() override = default;
-
-        std::unique_ptr<Base> initialization;
-        std::unique_ptr<Base> condition;
-        std::unique_ptr<Base> increment;
-        CommandSequence body;
-
-        Value evaluate(Context& context) override {
-            context.resetLoopControls();
-
-            if (initialization) {
-                initialization->evaluate(context);
-            }
-
-            while (true) {
-                // Проверяем break ДО условия
-                if (context.shouldBreak) break;
-
-                // Проверяем continue - пропускаем оставшуюся часть итерации
-                if (context.shouldContinue) {
-                    context.shouldContinue = false;
-                    goto increment; // Переходим прямо к инкременту
-                }
-
-                if (condition) {
-                    Value condValue = condition->evaluate(context);
-                    if (getIntFromValue(condValue, "условии for") == 0) {
-                        break;
-                    }
-                }
-
-                execute(body, context);
-
-                if (context.shouldReturn) break;
-                if (context.shouldBreak) break;
-
-                increment:
-                    if (increment) {
-                        increment->evaluate(context);
-                    }
-            }
 
-            context.resetLoopControls();
-            return std::monostate{};
-        }
+    /**
+     * @brief `target op= value`, where the target is a VariableReference or an ArrayIndex node.
+     */
+    struct Compound {
+        Index target;
+        Index value;
+        Kind op;        // Add, Subtract, Multiply or Divide
     };
 
-    struct ArrayCreation : Base {
-        ArrayCreation(std::vector<std::unique_ptr<expression::Base>> elements, std::string arrayName = "")
-            : elements(std::move(elements)), arrayName(std::move(arrayName)) {}
-        ~ArrayCreation() override = default;
-
-        std::vector<std::unique_ptr<expression::Base>> elements;
-        std::string arrayName;
-
-        Value evaluate(Context& context) override {
-            auto array = std::make_shared<Array>();
-            for (const auto& element : elements) {
-                array->elements.push_back(element->evaluate(context));
-            }
-
-            if (arrayName.empty()) {
-                arrayName = "__array_" + std::to_string(reinterpret_cast<uintptr_t>(array.get()));
-            }
-
-            context.arrays[arrayName] = array;
-
-            return arrayName; // Возвращаем имя массива как строку
-        }
+    /**
+     * @brief One node of a Tree; `kind` tells which member of the union is set.
+     */
+    struct Node {
+        explicit Node(Kind kind) : kind(kind), loop { kNone, kNone, kNone, {} } {}
+        Node(Kind kind, Index operand) : Node(kind) { this->operand = operand; }
+        Node(Kind kind, Binary binary) : Node(kind) { this->binary = binary; }
+        Node(Kind kind, Variable variable) : Node(kind) { this->variable = variable; }
+        Node(Kind kind, Call call) : Node(kind) { this->call = call; }
+        Node(Kind kind, Function function) : Node(kind) { this->function = function; }
+        Node(Kind kind, Branch branch) : Node(kind) { this->branch = branch; }
+        Node(Kind kind, Loop loop) : Node(kind) { this->loop = loop; }
+        Node(Kind kind, ForEach forEach) : Node(kind) { this->forEach = forEach; }
+        Node(Kind kind, List elements) : Node(kind) { this->elements = elements; }
+        Node(Kind kind, Element element) : Node(kind) { this->element = element; }
+        Node(Kind kind, Compound compound) : Node(kind) { this->compound = compound; }
+
+        Kind kind;
+        union {
+            Index operand;      // Constant (index in Tree constants), Return (kNone for `return;`), Postfix*
+            Binary binary;      // Add ... GreaterEqual
+            Variable variable;  // VariableReference, VariableAssignment, VariableDeclaration
+            Call call;          // FunctionCall
+            Function function;  // FunctionDeclaration
+            Branch branch;      // If, IfElse, While
+            Loop loop;          // For
+            ForEach forEach;    // ForEach
+            List elements;      // ArrayCreation
+            Element element;    // ArrayIndex, ArrayAssignment
+            Compound compound;  // CompoundAssignment
+        };
     };
+    static_assert(sizeof(Node) == 24, "Node is expected to stay compact");
 
-    struct ArrayIndex : Base {
-        ArrayIndex(std::unique_ptr<expression::Base> array, std::unique_ptr<expression::Base> index)
-            : array(std::move(array)), index(std::move(index)) {}
-        ~ArrayIndex() override = default;
-
-        std::unique_ptr<expression::Base> array;
-        std::unique_ptr<expression::Base> index;
-
-        Value evaluate(Context& context) override {
-            Value arrayNameValue = array->evaluate(context);
-            Value indexValue = index->evaluate(context);
-
-            if (!std::holds_alternative<std::string>(arrayNameValue)) {
-                throw std::runtime_error("Expected array name (string) for indexing");
-            }
-            if (!std::holds_alternative<int>(indexValue)) {
-                throw std::runtime_error("Expected integer index");
-            }
-
-            std::string arrayName = std::get<std::string>(arrayNameValue);
-            int idx = std::get<int>(indexValue);
-
-            auto it = context.arrays.find(arrayName);
-            if (it == context.arrays.end()) {
-                throw std::runtime_error("Array not found: " + arrayName);
-            }
-
-            const auto& arr = *it->second;
-
-            if (idx < 0 || idx >= static_cast<int>(arr.elements.size())) {
-                throw std::runtime_error(fmt::format("Array index {} out of bounds [0, {})",
-                    idx, arr.elements.size()));
-            }
-
-            return arr.elements[idx];
+    template <typename Op>
+    constexpr Kind binaryKind() {
+        if constexpr (std::is_same_v<Op, std::plus<>>) return Kind::Add;
+        else if constexpr (std::is_same_v<Op, std::minus<>>) return Kind::Subtract;
+        else if constexpr (std::is_same_v<Op, std::multiplies<>>) return Kind::Multiply;
+        else if constexpr (std::is_same_v<Op, std::divides<>>) return Kind::Divide;
+        else if constexpr (std::is_same_v<Op, std::equal_to<>>) return Kind::Equal;
+        else if constexpr (std::is_same_v<Op, std::not_equal_to<>>) return Kind::NotEqual;
+        else if constexpr (std::is_same_v<Op, std::less<>>) return Kind::Less;
+        else if constexpr (std::is_same_v<Op, std::greater<>>) return Kind::Greater;
+        else if constexpr (std::is_same_v<Op, std::less_equal<>>) return Kind::LessEqual;
+        else {
+            static_assert(std::is_same_v<Op, std::greater_equal<>>, "Unsupported binary operator");
+            return Kind::GreaterEqual;
         }
-    };
-
-    struct ArrayAssignment : Base {
-        ArrayAssignment(std::unique_ptr<expression::Base> array,
-                       std::unique_ptr<expression::Base> index,
-                       std::unique_ptr<expression::Base> value)
-            : array(std::move(array)), index(std::move(index)), value(std::move(value)) {}
-        ~ArrayAssignment() override = default;
-
-        std::unique_ptr<expression::Base> array;
-        std::unique_ptr<expression::Base> index;
-        std::unique_ptr<expression::Base> value;
-
-        Value evaluate(Context& context) override {
-            Value arrayNameValue = array->evaluate(context);
-            Value indexValue = index->evaluate(context);
-            Value newValue = value->evaluate(context);
-
-            if (!std::holds_alternative<std::string>(arrayNameValue)) {
-                throw std::runtime_error("Expected array name (string) for indexing");
-            }
-            if (!std::holds_alternative<int>(indexValue)) {
-                throw std::runtime_error("Expected integer index");
-            }
-
-            std::string arrayName = std::get<std::string>(arrayNameValue);
-            int idx = std::get<int>(indexValue);
-
-            // Находим массив в контексте
-            auto it = context.arrays.find(arrayName);
-            if (it == context.arrays.end()) {
-                throw std::runtime_error("Array not found: " + arrayName);
-            }
-
-            auto& arr = *it->second;
-            if (idx < 0 || idx >= static_cast<int>(arr.elements.size())) {
-                throw std::runtime_error(fmt::format("Array index {} out of bounds [0, {})", idx, arr.elements.size()));
-            }
+    }
 
-            arr.elements[idx] = newValue;
-            return newValue;
+    /**
+     * @brief Storage of a parsed program. Names are interned, so equal names share an index.
+     */
+    class Tree {
+    public:
+        Tree() = default;
+        Tree(const Tree&) = delete;
+        Tree& operator=(const Tree&) = delete;
+
+        Index add(Node node) {
+            mNodes.push_back(node);
+            return index(mNodes.size() - 1);
         }
-    };
-    struct PostfixIncrement : Base {
-    PostfixIncrement(std::unique_ptr<expression::Base> operand)
-        : operand(std::move(operand)) {}
-    ~PostfixIncrement() override = default;
-
-    std::unique_ptr<expression::Base> operand;
 
-    Value evaluate(Context& context) override {
-        // Получаем текущее значение переменной или элемента массива
-        Value currentValue = operand->evaluate(context);
-
-        if (!std::holds_alternative<int>(currentValue)) {
-            throw std::runtime_error("Postfix increment can only be applied to integers");
+        List addList(std::span<const Index> items) {
+            List list { index(mLists.size()), index(items.size()) };
+            mLists.insert(mLists.end(), items.begin(), items.end());
+            return list;
         }
 
-        int currentInt = std::get<int>(currentValue);
-        int newValue = currentInt + 1;
-
-        // Обновляем значение в контексте
-        if (auto variableRef = dynamic_cast<VariableReference*>(operand.get())) {
-            // Для переменной
-            context.variables[variableRef->name] = newValue;
+        Index addConstant(Value value) {
+            mConstants.push_back(std::move(value));
+            return index(mConstants.size() - 1);
         }
-        else if (auto arrayIndex = dynamic_cast<ArrayIndex*>(operand.get())) {
-            // Для элемента массива
-            Value arrayNameValue = arrayIndex->array->evaluate(context);
-            Value indexValue = arrayIndex->index->evaluate(context);
 
-            if (!std::holds_alternative<std::string>(arrayNameValue)) {
-                throw std::runtime_error("Expected array name for array element increment");
+        Index addName(std::string_view name) {
+            if (auto it = mNameIndex.find(name); it != mNameIndex.end()) {
+                return it->second;
             }
-            if (!std::holds_alternative<int>(indexValue)) {
-                throw std::runtime_error("Expected integer index for array element increment");
-            }
-
-            std::string arrayName = std::get<std::string>(arrayNameValue);
-            int idx = std::get<int>(indexValue);
-
-            auto it = context.arrays.find(arrayName);
-            if (it == context.arrays.end()) {
-                throw std::runtime_error("Array not found: " + arrayName);
-            }
-
-            it->second->elements[idx] = newValue;
-        }
-        else {
-            throw std::runtime_error("Postfix increment can only be applied to variables or array elements");
+            auto stored = mStrings.copy(name);
+            mNames.push_back(stored);
+            return mNameIndex[stored] = index(mNames.size() - 1);
         }
 
-        // Возвращаем старое значение (постфиксная семантика)
-        return currentInt;
-    }
-    };
-    struct PostfixDecrement : Base {
-        PostfixDecrement(std::unique_ptr<expression::Base> operand)
-            : operand(std::move(operand)) {}
-        ~PostfixDecrement() override = default;
-
-        std::unique_ptr<expression::Base> operand;
+        Node& operator[](Index node) { return mNodes[node]; }
+        const Node& operator[](Index node) const { return mNodes[node]; }
 
-        Value evaluate(Context& context) override {
-            // Получаем текущее значение переменной или элемента массива
-            Value currentValue = operand->evaluate(context);
-
-            if (!std::holds_alternative<int>(currentValue)) {
-                throw std::runtime_error("Postfix increment can only be applied to integers");
-            }
-
-            int currentInt = std::get<int>(currentValue);
-            int newValue = currentInt - 1;
-
-            // Обновляем значение в контексте
-            if (auto variableRef = dynamic_cast<VariableReference*>(operand.get())) {
-                // Для переменной
-                context.variables[variableRef->name] = newValue;
-            }
-            else if (auto arrayIndex = dynamic_cast<ArrayIndex*>(operand.get())) {
-                // Для элемента массива
-                Value arrayNameValue = arrayIndex->array->evaluate(context);
-                Value indexValue = arrayIndex->index->evaluate(context);
-
-                if (!std::holds_alternative<std::string>(arrayNameValue)) {
-                    throw std::runtime_error("Expected array name for array element increment");
-                }
-                if (!std::holds_alternative<int>(indexValue)) {
-                    throw std::runtime_error("Expected integer index for array element increment");
-                }
-
-                std::string arrayName = std::get<std::string>(arrayNameValue);
-                int idx = std::get<int>(indexValue);
-
-                auto it = context.arrays.find(arrayName);
-                if (it == context.arrays.end()) {
-                    throw std::runtime_error("Array not found: " + arrayName);
-                }
-
-                it->second->elements[idx] = newValue;
-            }
-            else {
-                throw std::runtime_error("Postfix increment can only be applied to variables or array elements");
-            }
-
-            // Возвращаем старое значение (постфиксная семантика)
-            return currentInt;
+        std::span<const Index> operator[](List list) const {
+            return std::span<const Index>(mLists).subspan(list.begin, list.size);
         }
-    };
-    struct ForEach : Base {
-        ForEach(std::string variableName,
-                std::unique_ptr<Base> collection,
-                CommandSequence body)
-            : variableName(std::move(variableName)),
-              collection(std::move(collection)),
-              body(std::move(body)) {}
-        ~ForEach() override = default;
-
-        std::string variableName;
-        std::unique_ptr<Base> collection;
-        CommandSequence body;
-
-        Value evaluate(Context& context) override {
-            context.resetLoopControls();
-
-            Value collectionValue = collection->evaluate(context);
-
-            if (!std::holds_alternative<std::string>(collectionValue)) {
-                throw std::runtime_error("Foreach expects array name");
-            }
-
-            std::string arrayName = std::get<std::string>(collectionValue);
-            auto it = context.arrays.find(arrayName);
-            if (it == context.arrays.end()) {
-                throw std::runtime_error("Array not found: " + arrayName);
-            }
-
-            for (const auto& element : it->second->elements) {
-                // Проверяем break ДО обработки элемента
-                if (context.shouldBreak) break;
 
-                // Проверяем continue - пропускаем этот элемент
-                if (context.shouldContinue) {
-                    context.shouldContinue = false;
-                    continue; // Переходим к следующему элементу
-                }
+        const Value& constant(Index constant) const { return mConstants[constant]; }
+        std::string_view name(Index name) const { return mNames[name]; }
 
-                context.variables[variableName] = element;
-                execute(body, context);
-
-                if (context.shouldReturn) break;
-                if (context.shouldBreak) break;
-            }
-
-            context.resetLoopControls();
-            return std::monostate{};
-        }
-    };
-    struct Break : Base {
-        Break() = default;
-        ~Break() override = default;
+        size_t size() const { return mNodes.size(); }
 
-        Value evaluate(Context& context) override {
-            context.shouldBreak = true;
-            return std::monostate{};
+        /**
+         * @brief Removes nodes, lists and constants so the tree can hold the next statement;
+         * interned names stay.
+         */
+        void clear() {
+            mNodes.clear();
+            mLists.clear();
+            mConstants.clear();
         }
-    };
-
-    struct Continue : Base {
-        Continue() = default;
-        ~Continue() override = default;
 
-        Value evaluate(Context& context) override {
-            context.shouldContinue = true;
-            return std::monostate{};
-        }
-    };
-    struct Function {
-        std::vector<std::string> parameters; // Имена параметров
-        expression::CommandSequence body;    // Тело функции
-        std::function<Value(Context& context, std::vector<Value> args)> value;
-
-        // Конструктор для пользовательских функций
-        Function(std::vector<std::string> params, expression::CommandSequence body)
-            : parameters(std::move(params)), body(std::move(body)) {
-            value = [&](Context& context, std::vector<Value> args) -> Value {
-                if (args.size() != parameters.size()) {
-                    throw std::runtime_error(fmt::format(
-                        "Function expects {} arguments, got {}", parameters.size(), args.size()));
-                }
-
-                // Сохраняем текущие переменные
-                auto oldVariables = std::move(context.variables);
-                context.variables.clear();
-
-                // Устанавливаем аргументы
-                for (size_t i = 0; i < parameters.size(); ++i) {
-                    context.variables[parameters[i]] = args[i];
-                }
-
-                // Выполняем тело функции
-                context.resetReturn();
-                expression::execute(body, context);
-
-                // Восстанавливаем переменные
-                auto result = context.returnValue.value_or(std::monostate{});
-
-                // ОБНОВЛЕННАЯ ПРОВЕРКА ТИПОВ - ДОБАВЛЕН CHAR
-                if (!std::holds_alternative<std::monostate>(result) &&
-                    !std::holds_alternative<int>(result) &&
-                    !std::holds_alternative<std::string>(result) &&
-                    !std::holds_alternative<char>(result)) { // Добавлена проверка для char
-                    throw std::runtime_error("Function returned invalid type");
-                    }
-
-                context.variables = std::move(oldVariables);
-                context.resetReturn();
-
-                return result;
-            };
+    private:
+        std::vector<Node> mNodes;
+        std::vector<Index> mLists;
+        std::vector<Value> mConstants;
+        std::vector<std::string_view> mNames;
+        std::unordered_map<std::string_view, Index> mNameIndex;
+        Arena mStrings;
+
+        static Index index(size_t value) {
+            if (value >= kNone) {
+                throw std::runtime_error("Program is too large");
+            }
+            return static_cast<Index>(value);
         }
-
-        // Конструктор для встроенных функций
-        Function(std::function<Value(Context&, std::vector<Value>)> func)
-            : value(std::move(func)) {}
     };
-    struct FunctionDeclaration : Base {
-        FunctionDeclaration(std::string name,
-                           std::vector<std::string> parameters,
-                           CommandSequence body)
-            : name(std::move(name)),
-              parameters(std::move(parameters)),
-              body(std::move(body)) {}
-
-        ~FunctionDeclaration() override = default;
 
-        std::string name;
-        std::vector<std::string> parameters;
-        CommandSequence body;
-
-        Value evaluate(Context& context) override;
-    };
-    struct IfElse : Base {
-        IfElse(std::unique_ptr<expression::Base> condition,
-               CommandSequence ifBody,
-               CommandSequence elseBody)
-            : condition(std::move(condition)),
-              ifBody(std::move(ifBody)),
-              elseBody(std::move(elseBody)) {}
-        ~IfElse() override = default;
-
-        std::unique_ptr<expression::Base> condition;
-        CommandSequence ifBody;
-        CommandSequence elseBody;
-
-        Value evaluate(Context& context) override {
-            if (getIntFromValue(condition->evaluate(context), "if-else condition") != 0) {
-                expression::execute(ifBody, context);
-            } else {
-                expression::execute(elseBody, context);
+    /**
+     * @brief Calls `f` with the index of every direct child of the node, in evaluation order.
+     * Absent optional children are skipped.
+     */
+    template <typename F>
+    void forEachChild(const Tree& tree, Index index, F&& f) {
+        const auto& node = tree[index];
+        auto child = [&](Index child) {
+            if (child != kNone) {
+                f(child);
             }
-            return std::monostate {};
-        }
-    };
-    struct VariableDeclaration : Base {
-        VariableDeclaration(std::string name, std::unique_ptr<expression::Base> initialValue = nullptr)
-            : name(std::move(name)), initialValue(std::move(initialValue)) {}
-        ~VariableDeclaration() override = default;
-
-        std::string name;
-        std::unique_ptr<expression::Base> initialValue;
-
-        Value evaluate(Context& context) override {
-            Value value = initialValue ? initialValue->evaluate(context) : std::monostate{};
-            context.variables[name] = value;
-            return value;
+        };
+        auto children = [&](List list) {
+            for (auto child : tree[list]) {
+                f(child);
+            }
+        };
+
+        switch (node.kind) {
+            case Kind::Constant:
+            case Kind::VariableReference:
+            case Kind::Break:
+            case Kind::Continue:
+                break;
+            case Kind::Add:
+            case Kind::Subtract:
+            case Kind::Multiply:
+            case Kind::Divide:
+            case Kind::Equal:
+            case Kind::NotEqual:
+            case Kind::Less:
+            case Kind::Greater:
+            case Kind::LessEqual:
+            case Kind::GreaterEqual:
+                child(node.binary.lhs);
+                child(node.binary.rhs);
+                break;
+            case Kind::VariableAssignment:
+            case Kind::VariableDeclaration:
+                child(node.variable.value);
+                break;
+            case Kind::FunctionCall:
+                children(node.call.args);
+                break;
+            case Kind::FunctionDeclaration:
+                children(node.function.body);
+                break;
+            case Kind::If:
+            case Kind::While:
+                child(node.branch.condition);
+                children(node.branch.body);
+                break;
+            case Kind::IfElse:
+                child(node.branch.condition);
+                children(node.branch.body);
+                children(node.branch.elseBody);
+                break;
+            case Kind::Return:
+            case Kind::PostfixIncrement:
+            case Kind::PostfixDecrement:
+                child(node.operand);
+                break;
+            case Kind::For:
+                child(node.loop.initialization);
+                child(node.loop.condition);
+                children(node.loop.body);
+                child(node.loop.increment);
+                break;
+            case Kind::ForEach:
+                child(node.forEach.collection);
+                children(node.forEach.body);
+                break;
+            case Kind::ArrayCreation:
+                children(node.elements);
+                break;
+            case Kind::ArrayIndex:
+                child(node.element.array);
+                child(node.element.index);
+                break;
+            case Kind::ArrayAssignment:
+                child(node.element.array);
+                child(node.element.index);
+                child(node.element.value);
+                break;
+            case Kind::CompoundAssignment:
+                child(node.compound.target);
+                child(node.compound.value);
+                break;
         }
-    };
-
-}
\ No newline at end of file
+    }
+}
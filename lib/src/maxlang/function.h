@@ -1,8 +1,11 @@
 #pragma once
 
 #include <functional>
+#include <memory>
+#include <span>
 #include <vector>
 #include <string>
+#include "bytecode.h"
 #include "value.h"
 
 namespace maxlang {
@@ -10,15 +13,56 @@ namespace maxlang {
     struct Context;
 
     struct Function {
+        // Встроенные функции без состояния вызываются напрямую, минуя std::function
+        using Native = Value (*)(Context& context, const std::vector<Value>& args);
+
+        // Типизированная функция C++ (см. native.h): adapter проверяет число аргументов,
+        // преобразует их прямо из регистров VM и вызывает target
+        using Adapter = Value (*)(void (*target)(), Context& context, std::span<const Value> args);
+
+        Native native = nullptr;
+        Adapter adapter = nullptr;
+        void (*target)() = nullptr;
         std::function<Value(Context& context, std::vector<Value> args)> nativeFunction;
+        // Тело пользовательской функции, выполняется VM в собственном кадре
+        std::shared_ptr<const bytecode::Prototype> prototype;
+        // Результат зависит только от аргументов: вызов с константами можно свернуть (см. optimizer.h)
+        bool pure = false;
+
+        /**
+         * @brief What the VM learns about a user function in the context that holds it: the call
+         * caches of its body and the result of purity analysis (see Memo). Copies of a Function
+         * start without it, so contexts never share it.
+         */
+        struct Linkage {
+            Linkage() = default;
+            Linkage(const Linkage&) {}
+            Linkage& operator=(const Linkage&) {
+                binding.reset();
+                purityVersion = 0;
+                return *this;
+            }
+
+            // Создаётся при первом вызове
+            std::shared_ptr<bytecode::Binding> binding;
+            // Результат анализа чистоты, действителен при совпадении с Functions::version()
+            uint64_t purityVersion = 0;
+            bool pure = false;
+        };
+        mutable Linkage linkage;
 
         Function() = default;
 
-        Function(std::function<Value(Context&, std::vector<Value>)> func)
-            : nativeFunction(std::move(func)) {}
+        Function(Native native, bool pure = false) : native(native), pure(pure) {}
+
+        Function(Adapter adapter, void (*target)(), bool pure = false) : adapter(adapter), target(target), pure(pure) {}
+
+        Function(std::function<Value(Context&, std::vector<Value>)> func, bool pure = false)
+            : nativeFunction(std::move(func)), pure(pure) {}
+
+        explicit Function(std::shared_ptr<const bytecode::Prototype> prototype)
+            : prototype(std::move(prototype)) {}
 
-        Value operator()(Context& context, std::vector<Value> args) {
-            return nativeFunction(context, std::move(args));
-        }
+        Value operator()(Context& context, std::vector<Value> args) const;
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,8 @@
+#include "functions.h"
+#include <atomic>
+
+uint64_t maxlang::Functions::nextVersion() {
+    // Версии начинаются с 1: пустой CallCache (версия 0) никогда не совпадает
+    static std::atomic<uint64_t> counter = 0;
+    return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include "function.h"
+#include "library.h"
+
+namespace maxlang {
+    /**
+     * @brief Functions of a context.
+     *
+     * Every change gives the table a new version, unique across all tables, so a call site can
+     * cache the Function it resolved and revalidate it with one comparison (see bytecode::CallCache).
+     * Names the table does not define are looked up in its Library, if one is set.
+     */
+    class Functions {
+    public:
+        Functions() = default;
+        Functions(const Functions& other) : mFunctions(other.mFunctions), mLibrary(other.mLibrary) {}
+        Functions& operator=(const Functions& other) {
+            mFunctions = other.mFunctions;
+            mLibrary = other.mLibrary;
+            mVersion = nextVersion();
+            return *this;
+        }
+
+        /**
+         * @brief Returns the function for assignment, adding an empty one if needed (it shadows
+         * the library function of the same name).
+         * Invalidates cached lookups, so do not keep the reference to modify it later.
+         */
+        Function& operator[](const std::string& name) {
+            mVersion = nextVersion();
+            return mFunctions[name];
+        }
+
+        /**
+         * @brief Returns the function or nullptr if it is not defined.
+         */
+        const Function* find(std::string_view name) const {
+            if (auto it = mFunctions.find(name); it != mFunctions.end()) {
+                return &it->second;
+            }
+            return mLibrary ? mLibrary->function(name) : nullptr;
+        }
+
+        bool contains(std::string_view name) const { return find(name) != nullptr; }
+
+        /**
+         * @brief Removes a function defined in the table. Library functions cannot be removed: if
+         * `name` shadowed one, it becomes visible again.
+         */
+        void erase(std::string_view name) {
+            if (auto it = mFunctions.find(name); it != mFunctions.end()) {
+                mFunctions.erase(it);
+                mVersion = nextVersion();
+            }
+        }
+
+        uint64_t version() const { return mVersion; }
+
+        /**
+         * @brief Sets the fallback table; the library must outlive the table. nullptr detaches it.
+         */
+        void setLibrary(const Library* library) {
+            mLibrary = library;
+            mVersion = nextVersion();
+        }
+
+        const Library* library() const { return mLibrary; }
+
+    private:
+        static uint64_t nextVersion();
+
+        // Адреса узлов std::map стабильны, поэтому кэш может хранить указатель на Function
+        std::map<std::string, Function, std::less<>> mFunctions;
+        const Library* mLibrary = nullptr;
+        uint64_t mVersion = nextVersion();
+    };
+}
@@ -1,6 +1,8 @@
 #include "lexer.h"
+#include "scanner.h"
 #include "fmt/format.h"
 #include <charconv>
+#include <limits>
 #include <iostream>
 #include <map>
 #include <ranges>
@@ -9,263 +11,268 @@
 using namespace maxlang;
 using namespace maxlang::token;
 
-std::vector<std::pair<token::Any,int>> maxlang::lexer::process(std::string_view code) {
-    int line = 1;
-    bool singleLineComment = false;
-    bool multiLineComment = false;
-    std::vector<std::pair<token::Any,int>> result;
+maxlang::lexer::Lexer::Lexer(std::string_view code) : mCode(code), mPosition(code.begin()) {
+    if (code.size() >= std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("Program is too large");
+    }
+}
 
-    for (auto it = code.begin(); it != code.end(); ++it) {
-        auto remainingString = std::ranges::subrange(it, code.end());
-        auto findBlank = [&] {
-            return std::ranges::find_if(remainingString, [](char c) {
-                switch (c) {
-                    case ' ':
-                    case '\t':
-                    case '\n':
-                        return true;
-                    default:
-                        return false;
-                }
-            });
-        };
-        if (singleLineComment) {
-            if (*it == '\n') {
-                singleLineComment = false;
-                line++;
-            }
-            continue;
-        }
-        else{
-            if (multiLineComment) {
-                if (*it == '\n') {
-                    line++;
-                }
-                if (std::next(it) != code.end() && *it == '*' && *std::next(it) == '/') {
-                    it++; // Пропускаем '/'
-                    multiLineComment = false;
-                }
-                continue;
-            }
-            else {
-                switch (*it) {
-                    default:
-                        if (std::isalpha(*it)) {
-                            auto blank = std::ranges::find_if(remainingString, [](char c) {
-                                return !std::isalnum(c) && c != '_';
-                            });
-                            std::string_view valueString(it, blank);
-                            it = std::prev(blank);
+token::Stream maxlang::lexer::process(std::string_view code) {
+    Lexer lexer(code);
+    token::Stream result(code);
+    lexer.fill(result, std::numeric_limits<size_t>::max());
+    return result;
+}
 
-                            static std::map<std::string_view, Keyword> keywords = {
-                                {"return", Keyword::RETURN},
-                                {"fn", Keyword::FN},
-                                {"if", Keyword::IF},
-                                {"else", Keyword::ELSE},
-                                {"for", Keyword::FOR},
-                                {"while", Keyword::WHILE},
-                                {"foreach", Keyword::FOREACH},
-                                {"in", Keyword::IN},
-                                {"break", Keyword::BREAK},
-                                {"continue", Keyword::CONTINUE},
-                            };
+bool maxlang::lexer::Lexer::fill(token::Stream& result, size_t size) {
+    auto code = mCode;
+    // Сканеры из scanner.h работают с указателями
+    auto pointer = [&](std::string_view::iterator it) { return code.data() + (it - code.begin()); };
+    auto iterator = [&](const char* p) { return code.begin() + (p - code.data()); };
+    // Номер строки нужен только для сообщений об ошибках
+    auto lineOf = [&](std::string_view::iterator it) { return 1 + scan::countLines(code.data(), pointer(it)); };
 
-                            if (auto keyword = keywords.find(valueString); keyword != keywords.end()) {
-                                result.push_back(std::make_pair(keyword->second,line));
-                                break;
-                            }
-                            result.push_back(std::make_pair(Identifier{.value = std::string(valueString)},line));
-                            break;
-                        }
+    auto it = mPosition;
+    for (; it != code.end() && result.size() < size; ++it) {
+        auto remainingString = std::ranges::subrange(it, code.end());
+        auto start = static_cast<uint32_t>(it - code.begin());
+        switch (*it) {
+            default:
+                if (std::isalpha(*it)) {
+                    auto blank = iterator(scan::identifierEnd(pointer(it), pointer(code.end())));
+                    std::string_view valueString(it, blank);
+                    it = std::prev(blank);
 
-                        if (std::isdigit(*it)) {
-                            bool isFloat = false;
-                            auto end = std::ranges::find_if(remainingString, [&](char c) {
-                                if (c == '.') {
-                                    if (isFloat) return true; // Уже была точка
-                                    isFloat = true;
-                                    return false;
-                                }
-                                return !std::isdigit(c);
-                            });
+                    static std::map<std::string_view, Keyword> keywords = {
+                        {"return", Keyword::RETURN},
+                        {"fn", Keyword::FN},
+                        {"if", Keyword::IF},
+                        {"else", Keyword::ELSE},
+                        {"for", Keyword::FOR},
+                        {"while", Keyword::WHILE},
+                        {"foreach", Keyword::FOREACH},
+                        {"in", Keyword::IN},
+                        {"break", Keyword::BREAK},
+                        {"continue", Keyword::CONTINUE},
+                    };
 
-                            std::string_view numberString(it, end);
+                    if (auto keyword = keywords.find(valueString); keyword != keywords.end()) {
+                        result.push(keyword->second, start);
+                        break;
+                    }
+                    result.push(Identifier{.value = valueString}, start);
+                    break;
+                }
 
-                            if (isFloat) {
-                                double floatValue = 0.0;
-                                // Используем std::stod для простоты (хотя это не самый безопасный способ)
-                                try {
-                                    floatValue = std::stod(std::string(numberString));
-                                } catch (...) {
-                                    throw std::runtime_error(fmt::format("Invalid float literal: {}, at line {}", numberString, line));
-                                }
-                                result.push_back(std::make_pair(Float{.value = floatValue}, line));
-                            } else {
-                                int integer = 0;
-                                std::from_chars(numberString.data(), numberString.data() + numberString.size(), integer);
-                                result.push_back(std::make_pair(Integer{.value = integer}, line));
-                            }
-                            it = std::prev(end);
-                            break;
+                if (std::isdigit(*it)) {
+                    bool isFloat = false;
+                    auto end = std::ranges::find_if(remainingString, [&](char c) {
+                        if (c == '.') {
+                            if (isFloat) return true; // Уже была точка
+                            isFloat = true;
+                            return false;
                         }
+                        return !std::isdigit(c);
+                    });
 
-                        throw std::runtime_error(fmt::format("Unexpected character: '{}', at line {}", *it, line));
+                    std::string_view numberString(it, end);
 
-                    case ' ':
-                    case '\r':
-                    case '\t':
-                        break;
+                    auto parse = [&](auto& value, const char* what) {
+                        auto [end, error] = std::from_chars(numberString.data(), numberString.data() + numberString.size(), value);
+                        if (error != std::errc() || end != numberString.data() + numberString.size()) {
+                            throw std::runtime_error(fmt::format("Invalid {} literal: {}, at line {}", what, numberString, lineOf(it)));
+                        }
+                    };
+                    if (isFloat) {
+                        double floatValue = 0.0;
+                        parse(floatValue, "float");
+                        result.push(Float{.value = floatValue}, start);
+                    } else {
+                        int integer = 0;
+                        parse(integer, "integer");
+                        result.push(Integer{.value = integer}, start);
+                    }
+                    it = std::prev(end);
+                    break;
+                }
 
-                    case '\n':
-                        ++line;
-                        break;
+                throw std::runtime_error(fmt::format("Unexpected character: '{}', at line {}", *it, lineOf(it)));
 
-                    case '(':
-                        result.push_back(std::make_pair(LPar{},line));
-                        break;
-                    case ')':
-                        result.push_back(std::make_pair(RPar{},line));
-                        break;
-                    case '{':
-                        result.push_back(std::make_pair(LCurlyBracket{},line));
-                        break;
-                    case '}':
-                        result.push_back(std::make_pair(RCurlyBracket{},line));
-                        break;
-                    case '[':
-                        result.push_back(std::make_pair(LSquareBracket{},line));
-                        break;
-                    case ']':
-                        result.push_back(std::make_pair(RSquareBracket{},line));
-                        break;
-                    case '<':
-                        if ((std::next(it) != code.end())) {
-                            if (*std::next(it) == '=') {
-                                it++;
-                                result.push_back(std::make_pair(LAngleBracketEqual{},line));
-                                break;
-                            }
-                        }
-                        result.push_back(std::make_pair(LAngleBracket{},line));
+            case ' ':
+            case '\r':
+            case '\t':
+            case '\n':
+                it = std::prev(iterator(scan::skipBlank(pointer(it), pointer(code.end()))));
+                break;
+
+            case '(':
+                result.push(LPar{}, start);
+                break;
+            case ')':
+                result.push(RPar{}, start);
+                break;
+            case '{':
+                result.push(LCurlyBracket{}, start);
+                break;
+            case '}':
+                result.push(RCurlyBracket{}, start);
+                break;
+            case '[':
+                result.push(LSquareBracket{}, start);
+                break;
+            case ']':
+                result.push(RSquareBracket{}, start);
+                break;
+            case '<':
+                if ((std::next(it) != code.end())) {
+                    if (*std::next(it) == '=') {
+                        it++;
+                        result.push(LAngleBracketEqual{}, start);
                         break;
-                    case '>':
-                        if ((std::next(it) != code.end())) {
-                            if (*std::next(it) == '=') {
-                                it++;
-                                result.push_back(std::make_pair(RAngleBracketEqual{},line));
-                                break;
-                            }
-                        }
-                        result.push_back(std::make_pair(RAngleBracket{},line));
+                    }
+                }
+                result.push(LAngleBracket{}, start);
+                break;
+            case '>':
+                if ((std::next(it) != code.end())) {
+                    if (*std::next(it) == '=') {
+                        it++;
+                        result.push(RAngleBracketEqual{}, start);
                         break;
-                    case ';':
-                        result.push_back(std::make_pair(Semicolon{},line));
+                    }
+                }
+                result.push(RAngleBracket{}, start);
+                break;
+            case ';':
+                result.push(Semicolon{}, start);
+                break;
+            case '+':
+                if ((std::next(it) != code.end())) {
+                    if (*std::next(it) == '+') {
+                        it++;
+                        result.push(PlusPlus{}, start);
                         break;
-                    case '+':
-                        if ((std::next(it) != code.end())) {
-                            if (*std::next(it) == '+') {
-                                it++;
-                                result.push_back(std::make_pair(PlusPlus{},line));
-                                break;
-                            }
-                        }
-                        result.push_back(std::make_pair(Plus{},line));
+                    }
+                    if (*std::next(it) == '=') {
+                        it++;
+                        result.push(PlusEqual{}, start);
                         break;
-                    case '-':
-                        if ((std::next(it) != code.end())) {
-                            if (*std::next(it) == '-') {
-                                it++;
-                                result.push_back(std::make_pair(MinusMinus{},line));
-                                break;
-                            }
-                            if (std::isdigit(*std::next(it))) {
-                                result.push_back(std::make_pair(Integer{.value = 0},line));
-                                result.push_back(std::make_pair(Minus{},line));
-                                break;
-                            }
-                            if (std::isalpha(*std::next(it))) {
-                                result.push_back(std::make_pair(Integer{.value = 0},line));
-                                result.push_back(std::make_pair(Minus{},line));
-                                break;
-                            }
-                        }
-                        result.push_back(std::make_pair(Minus{},line));
+                    }
+                }
+                result.push(Plus{}, start);
+                break;
+            case '-':
+                if ((std::next(it) != code.end())) {
+                    if (*std::next(it) == '-') {
+                        it++;
+                        result.push(MinusMinus{}, start);
                         break;
-                    case '*':
-                        result.push_back(std::make_pair(Asterisk{},line));
+                    }
+                    if (*std::next(it) == '=') {
+                        it++;
+                        result.push(MinusEqual{}, start);
                         break;
-                    case '/':
-                        if ((std::next(it) != code.end())) {
-                            if (*std::next(it) == '/') {
-                                it++;
-                                singleLineComment = true;
-                                break;
-                            }
-                            if (*std::next(it) == '*') {
-                                it++;
-                                multiLineComment = true;
-                                break;
-                            }
-                        }
-                        result.push_back(std::make_pair(Slash{},line));
+                    }
+                    if (std::isdigit(*std::next(it))) {
+                        result.push(Integer{.value = 0}, start);
+                        result.push(Minus{}, start);
                         break;
-                    case ',':
-                        result.push_back(std::make_pair(Comma{},line));
+                    }
+                    if (std::isalpha(*std::next(it))) {
+                        result.push(Integer{.value = 0}, start);
+                        result.push(Minus{}, start);
                         break;
-                    case '.':
-                        result.push_back(std::make_pair(Dot{},line));
+                    }
+                }
+                result.push(Minus{}, start);
+                break;
+            case '*':
+                if (std::next(it) != code.end() && *std::next(it) == '=') {
+                    it++;
+                    result.push(AsteriskEqual{}, start);
+                    break;
+                }
+                result.push(Asterisk{}, start);
+                break;
+            case '/':
+                if ((std::next(it) != code.end())) {
+                    if (*std::next(it) == '/') {
+                        // Перевод строки разберёт следующая итерация
+                        it = std::prev(iterator(scan::find(pointer(it), pointer(code.end()), '\n')));
                         break;
-                    case '=':
-                        if (std::next(it) != code.end()) {
-                            if (*std::next(it) == '=') {
-                                it++;
-                                result.push_back(std::make_pair(Equal2{},line));
-                                break;
-                            }
-                        }
-                        result.push_back(std::make_pair(Equal{},line));
+                    }
+                    if (*std::next(it) == '*') {
+                        // Незакрытый комментарий тянется до конца текста
+                        auto close = iterator(scan::commentEnd(pointer(it) + 2, pointer(code.end())));
+                        it = close == code.end() ? std::prev(code.end()) : std::next(close);
                         break;
-                    case '!':
-                        if (std::next(it) != code.end()) {
-                            if (*std::next(it) == '=') {
-                                it++;
-                                result.push_back(std::make_pair(NoEqual{},line));
-                                break;
-                            }
-                        }
+                    }
+                    if (*std::next(it) == '=') {
+                        it++;
+                        result.push(SlashEqual{}, start);
                         break;
-                    case '\'': {
-                        if (std::next(it) == code.end() || std::next(std::next(it)) == code.end()) {
-                            throw std::runtime_error(fmt::format("Char literal is not finished, at line {}", line));
-                        }
-
-                        char charValue = *std::next(it);
-
-                        // Проверяем закрывающую кавычку
-                        // if (*std::next(std::next(it)) != '\'') {
-                        //     throw std::runtime_error(fmt::format("Char literal must be exactly one character, at line {}", line));
-                        // }
-
-                        result.push_back(std::make_pair(token::Char{.value = charValue}, line));
-                        it = std::next(std::next(it)); // Пропускаем символ и закрывающую кавычку
+                    }
+                }
+                result.push(Slash{}, start);
+                break;
+            case ',':
+                result.push(Comma{}, start);
+                break;
+            case '.':
+                result.push(Dot{}, start);
+                break;
+            case '=':
+                if (std::next(it) != code.end()) {
+                    if (*std::next(it) == '=') {
+                        it++;
+                        result.push(Equal2{}, start);
                         break;
                     }
-
-                    case '"': {
-                        auto string_end = std::ranges::find(std::ranges::subrange(std::next(remainingString.begin()), remainingString.end()), '"');
-                        if (string_end == remainingString.end()) {
-                            throw std::runtime_error(fmt::format("String literal is not finished, at line {}", line));
-                        }
-                        result.push_back(std::make_pair(String{.value = std::string(std::next(it), string_end)},line));
-                        it = string_end;
+                }
+                result.push(Equal{}, start);
+                break;
+            case '!':
+                if (std::next(it) != code.end()) {
+                    if (*std::next(it) == '=') {
+                        it++;
+                        result.push(NoEqual{}, start);
                         break;
                     }
                 }
-                if (it == code.end()) {
-                    break;
+                break;
+            case '\'': {
+                if (std::next(it) == code.end() || std::next(std::next(it)) == code.end()) {
+                    throw std::runtime_error(fmt::format("Char literal is not finished, at line {}", lineOf(it)));
                 }
+
+                // 'x' - символ, '' и 'xyz' - строки
+                auto quote_end = iterator(scan::find(pointer(it) + 1, pointer(code.end()), '\''));
+                if (quote_end == code.end()) {
+                    throw std::runtime_error(fmt::format("Char literal is not finished, at line {}", lineOf(it)));
+                }
+                if (std::distance(it, quote_end) == 2) {
+                    result.push(token::Char{.value = *std::next(it)}, start);
+                } else {
+                    result.push(String{.value = std::string_view(std::next(it), quote_end)}, start);
+                }
+                it = quote_end;
+                break;
+            }
+
+            case '"': {
+                auto string_end = iterator(scan::find(pointer(it) + 1, pointer(code.end()), '"'));
+                if (string_end == code.end()) {
+                    throw std::runtime_error(fmt::format("String literal is not finished, at line {}", lineOf(it)));
+                }
+                result.push(String{.value = std::string_view(std::next(it), string_end)}, start);
+                it = string_end;
+                break;
             }
         }
+        if (it == code.end()) {
+            break;
+        }
     }
-    return result;
+    mPosition = it;
+    return it != code.end();
 }
\ No newline at end of file
@@ -17,7 +17,7 @@
  *
  * Will be converted into:
  * ```
- * std::vector<Token> {
+ * token::Stream {
  *   Keyword::FN,
  *   Identifier{ "main" },
  *   LPar,
@@ -33,5 +33,27 @@
  * ```
  */
 namespace maxlang::lexer {
-    std::vector<std::pair<token::Any,int>> process(std::string_view code);
+    /**
+     * @brief Lexes `code` on demand, a few tokens at a time.
+     */
+    class Lexer {
+    public:
+        explicit Lexer(std::string_view code);
+
+        /**
+         * @brief Appends tokens to `tokens` until it holds `size` of them; returns false once
+         * the whole input has been lexed.
+         */
+        bool fill(token::Stream& tokens, size_t size);
+
+    private:
+        std::string_view mCode;
+        std::string_view::iterator mPosition;
+    };
+
+    /**
+     * @brief Identifier and String tokens refer into `code` instead of copying it, so `code`
+     * has to outlive the stream.
+     */
+    token::Stream process(std::string_view code);
 }
@@ -0,0 +1,42 @@
+#include "library.h"
+#include <algorithm>
+
+namespace {
+    template <typename T>
+    void sortByName(std::vector<std::pair<std::string_view, T>>& entries) {
+        std::ranges::sort(entries, {}, [](const auto& entry) { return entry.first; });
+    }
+
+    template <typename T>
+    const T* find(const std::vector<std::pair<std::string_view, T>>& entries, std::string_view name) {
+        auto it = std::ranges::lower_bound(entries, name, {}, [](const auto& entry) { return entry.first; });
+        return it != entries.end() && it->first == name ? &it->second : nullptr;
+    }
+}
+
+maxlang::Library::Library(std::vector<std::pair<std::string_view, Function>> functions,
+                          std::vector<std::pair<std::string_view, Value>> variables)
+    : mFunctions(std::move(functions)), mVariables(std::move(variables)) {
+    sortByName(mFunctions);
+    sortByName(mVariables);
+
+    // FNV-1a по именам через '\0', в порядке сортировки
+    mFingerprint = 14695981039346656037ull;
+    for (const auto& [name, function] : mFunctions) {
+        if (!function.pure) {
+            continue;
+        }
+        for (unsigned char c : name) {
+            mFingerprint = (mFingerprint ^ c) * 1099511628211ull;
+        }
+        mFingerprint *= 1099511628211ull;
+    }
+}
+
+const maxlang::Function* maxlang::Library::function(std::string_view name) const {
+    return find(mFunctions, name);
+}
+
+const maxlang::Value* maxlang::Library::variable(std::string_view name) const {
+    return find(mVariables, name);
+}
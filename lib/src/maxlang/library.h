@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "function.h"
+#include "value.h"
+
+namespace maxlang {
+    /**
+     * @brief Immutable table of builtin functions and variables that contexts consult when a name
+     * is not defined in their own tables (see Functions::setLibrary and Variables::setLibrary).
+     *
+     * A library is built once and shared by every context that uses it, so attaching it costs
+     * nothing; definitions made by the program shadow its names. It is never modified, so any
+     * number of threads can use one library at the same time.
+     */
+    class Library {
+    public:
+        Library(std::vector<std::pair<std::string_view, Function>> functions,
+                std::vector<std::pair<std::string_view, Value>> variables);
+
+        /**
+         * @brief Returns the function or nullptr if the library does not define it.
+         */
+        const Function* function(std::string_view name) const;
+
+        /**
+         * @brief Returns the variable or nullptr if the library does not define it.
+         */
+        const Value* variable(std::string_view name) const;
+
+        /**
+         * @brief Hash of the names of the pure functions: constant folding stores their results in
+         * compiled code, so cached programs are keyed by it (see cache::key).
+         */
+        uint64_t fingerprint() const { return mFingerprint; }
+
+    private:
+        // Отсортированы по имени, поиск двоичный
+        std::vector<std::pair<std::string_view, Function>> mFunctions;
+        std::vector<std::pair<std::string_view, Value>> mVariables;
+        uint64_t mFingerprint = 0;
+    };
+}
@@ -0,0 +1,44 @@
+#include "memo.h"
+#include "util.h"
+#include <functional>
+#include <string_view>
+
+using namespace maxlang;
+
+size_t Memo::Hash::operator()(const KeyView& key) const {
+    size_t result = std::hash<const void*> {}(key.function);
+    for (const auto& arg : key.args) {
+        size_t h = std::visit(
+            match {
+                [](std::monostate) -> size_t { return 0; },
+                [](int v) -> size_t { return std::hash<int> {}(v); },
+                [](double v) -> size_t { return std::hash<double> {}(v); },
+                [](const String& v) -> size_t { return std::hash<std::string_view> {}(v.view()); },
+                [](char v) -> size_t { return std::hash<char> {}(v); },
+                [](const ArrayRef& v) -> size_t { return std::hash<const void*> {}(v.get()); },
+            },
+            arg);
+        result ^= h + arg.index() + 0x9e3779b97f4a7c15ULL + (result << 6) + (result >> 2);
+    }
+    return result;
+}
+
+const Value* Memo::find(const bytecode::Prototype* function, std::span<const Value> args) {
+    auto it = mEntries.find(KeyView { function, args });
+    if (it == mEntries.end()) {
+        ++mMisses;
+        return nullptr;
+    }
+    ++mHits;
+    return &it->second;
+}
+
+void Memo::insert(const bytecode::Prototype* function, std::vector<Value> args, Value result) {
+    if (mCapacity == 0 || std::holds_alternative<ArrayRef>(result)) {
+        return;
+    }
+    if (mEntries.size() >= mCapacity) {
+        mEntries.clear();
+    }
+    mEntries.emplace(Key { function, std::move(args) }, std::move(result));
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+#include "value.h"
+
+namespace maxlang {
+    namespace bytecode {
+        struct Prototype;
+    }
+
+    /**
+     * @brief Bounded table of results of pure user functions, keyed by the function and the
+     * argument values. Memoization is opt-in: `context.memo.emplace(capacity)`.
+     *
+     * A function is pure if its body does not touch arrays or define functions, and it only calls
+     * pure builtins and pure user functions. Calls with array arguments are never memoized.
+     */
+    class Memo {
+    public:
+        explicit Memo(size_t capacity = 4096) : mCapacity(capacity) {}
+
+        /**
+         * @brief Returns the stored result or nullptr, counting a hit or a miss.
+         */
+        const Value* find(const bytecode::Prototype* function, std::span<const Value> args);
+
+        /**
+         * @brief Stores a result. When the table is full it is cleared first.
+         */
+        void insert(const bytecode::Prototype* function, std::vector<Value> args, Value result);
+
+        /**
+         * @brief Drops all results if the functions of the context changed since they were stored.
+         */
+        void validate(uint64_t functionsVersion) {
+            if (functionsVersion != mFunctionsVersion) {
+                mEntries.clear();
+                mFunctionsVersion = functionsVersion;
+            }
+        }
+
+        void clear() { mEntries.clear(); }
+
+        size_t size() const { return mEntries.size(); }
+        size_t capacity() const { return mCapacity; }
+        size_t hits() const { return mHits; }
+        size_t misses() const { return mMisses; }
+
+    private:
+        struct Key {
+            const bytecode::Prototype* function;
+            std::vector<Value> args;
+        };
+        struct KeyView {
+            const bytecode::Prototype* function;
+            std::span<const Value> args;
+        };
+        struct Hash {
+            using is_transparent = void;
+            size_t operator()(const KeyView& key) const;
+            size_t operator()(const Key& key) const { return (*this)(KeyView { key.function, key.args }); }
+        };
+        struct Equal {
+            using is_transparent = void;
+            static KeyView view(const Key& key) { return { key.function, key.args }; }
+            static KeyView view(const KeyView& key) { return key; }
+            bool operator()(const auto& lhs, const auto& rhs) const {
+                auto l = view(lhs);
+                auto r = view(rhs);
+                return l.function == r.function && std::ranges::equal(l.args, r.args);
+            }
+        };
+
+        std::unordered_map<Key, Value, Hash, Equal> mEntries;
+        size_t mCapacity;
+        uint64_t mFunctionsVersion = 0;
+        size_t mHits = 0;
+        size_t mMisses = 0;
+    };
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "fmt/format.h"
+#include "function.h"
+#include "util.h"
+#include "value.h"
+
+/**
+ * @details
+ * Typed native functions: plain C++ functions such as `double(double, double)` wrapped into
+ * a Function. The number of arguments and their conversions are derived from the signature at
+ * compile time, and the VM passes the arguments as a span over its registers, without building
+ * a std::vector for every call.
+ *
+ * Supported parameter types are int, double, bool, char, String, ArrayRef and Value (by value or
+ * by const reference); a leading `Context&` parameter receives the calling context and is not
+ * counted as an argument. The result can be void or any type a Value can be made of.
+ */
+namespace maxlang::native {
+    template <typename T>
+    struct Argument {
+        static_assert(!sizeof(T), "Unsupported parameter type of a native function");
+    };
+
+    template <>
+    struct Argument<Value> {
+        static const Value& from(const Value& value, size_t) { return value; }
+    };
+
+    template <>
+    struct Argument<int> {
+        static int from(const Value& value, size_t index) {
+            if (const auto* result = std::get_if<int>(&value)) {
+                return *result;
+            }
+            return getIntFromValue(value, fmt::format("аргументе {}", index + 1));
+        }
+    };
+
+    template <>
+    struct Argument<bool> {
+        static bool from(const Value& value, size_t index) { return Argument<int>::from(value, index) != 0; }
+    };
+
+    template <>
+    struct Argument<double> {
+        static double from(const Value& value, size_t index) {
+            if (const auto* result = std::get_if<double>(&value)) {
+                return *result;
+            }
+            return getDoubleFromValue(value, fmt::format("аргументе {}", index + 1));
+        }
+    };
+
+    template <typename T>
+    struct Alternative {
+        static const T& from(const Value& value, size_t index) {
+            if (const auto* result = std::get_if<T>(&value)) {
+                return *result;
+            }
+            throw std::runtime_error(fmt::format("Unexpected type of argument {}", index + 1));
+        }
+    };
+
+    template <>
+    struct Argument<char> : Alternative<char> {};
+
+    template <>
+    struct Argument<String> : Alternative<String> {};
+
+    template <>
+    struct Argument<ArrayRef> : Alternative<ArrayRef> {};
+
+    template <typename R, typename... Args>
+    Value invoke(R (*function)(Args...), std::span<const Value> args, auto&&... leading) {
+        if (args.size() != sizeof...(Args) - sizeof...(leading)) {
+            throw std::runtime_error(fmt::format(
+                "Function expects {} arguments, got {}", sizeof...(Args) - sizeof...(leading), args.size()));
+        }
+        return [&]<size_t... I>(std::index_sequence<I...>) -> Value {
+            using Parameters = std::tuple<Args...>;
+            constexpr size_t skip = sizeof...(leading);
+            if constexpr (std::is_void_v<R>) {
+                function(leading..., Argument<std::remove_cvref_t<std::tuple_element_t<skip + I, Parameters>>>::from(args[I], I)...);
+                return std::monostate();
+            } else if constexpr (std::is_same_v<R, bool>) {
+                return function(leading..., Argument<std::remove_cvref_t<std::tuple_element_t<skip + I, Parameters>>>::from(args[I], I)...) ? 1 : 0;
+            } else {
+                return Value(function(leading..., Argument<std::remove_cvref_t<std::tuple_element_t<skip + I, Parameters>>>::from(args[I], I)...));
+            }
+        }(std::make_index_sequence<sizeof...(Args) - sizeof...(leading)>());
+    }
+
+    template <typename R, typename... Args>
+    Value adapt(void (*target)(), Context&, std::span<const Value> args) {
+        return invoke(reinterpret_cast<R (*)(Args...)>(target), args);
+    }
+
+    template <typename R, typename... Args>
+    Value adaptWithContext(void (*target)(), Context& context, std::span<const Value> args) {
+        return invoke(reinterpret_cast<R (*)(Context&, Args...)>(target), args, context);
+    }
+
+    /**
+     * @brief Wraps a C++ function into a Function; see above for the supported signatures.
+     */
+    template <typename R, typename... Args>
+    Function wrap(R (*function)(Args...), bool pure = false) {
+        return Function(&adapt<R, Args...>, reinterpret_cast<void (*)()>(function), pure);
+    }
+
+    template <typename R, typename... Args>
+    Function wrap(R (*function)(Context&, Args...), bool pure = false) {
+        return Function(&adaptWithContext<R, Args...>, reinterpret_cast<void (*)()>(function), pure);
+    }
+}
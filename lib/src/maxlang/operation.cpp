@@ -0,0 +1,22 @@
+#include "operation.h"
+#include "array.h"
+
+namespace maxlang::operation {
+
+    bool equal(const Value& lhs, const Value& rhs) {
+        // Массивы сравниваются поэлементно
+        if (std::holds_alternative<ArrayRef>(lhs) && std::holds_alternative<ArrayRef>(rhs)) {
+            return *std::get<ArrayRef>(lhs) == *std::get<ArrayRef>(rhs);
+        }
+
+        // Стандартная логика для других типов
+        return std::visit(
+            maxlang::match {
+              [](auto&& l, auto&& r) -> bool {
+                  return l == r;
+              },
+            },
+            lhs, rhs);
+    }
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <functional>
+#include <stdexcept>
+#include <typeinfo>
+#include "value.h"
+#include "context.h"
+#include "fmt/format.h"
+#include "util.h"
+
+/**
+ * @details
+ * Semantics of the binary operators of the language, shared by everything that has to
+ * compute them (the VM, and compile-time passes).
+ */
+namespace maxlang::operation {
+    template <typename Op>
+    Value binary(const Value& lhs, const Value& rhs) {
+        return std::visit(
+            maxlang::match {
+              [](auto&& lhs_val, auto&& rhs_val) -> Value {
+                  if constexpr (requires { Op{}(lhs_val, rhs_val); }) {
+                      return Op{}(lhs_val, rhs_val);
+                  }
+                  throw std::runtime_error(fmt::format("Can't perform operation on {} and {}",
+                      typeid(lhs_val).name(), typeid(rhs_val).name()));
+              },
+            },
+            lhs, rhs);
+    }
+
+    /**
+     * @brief Implements `==`. Two arrays are compared element-wise.
+     */
+    bool equal(const Value& lhs, const Value& rhs);
+}
@@ -0,0 +1,203 @@
+#include "optimizer.h"
+#include "operation.h"
+#include <optional>
+#include <ostream>
+#include <set>
+#include <sstream>
+
+using namespace maxlang;
+using expression::Kind;
+
+namespace {
+    const char* symbol(Kind kind) {
+        switch (kind) {
+            case Kind::Add: return "+";
+            case Kind::Subtract: return "-";
+            case Kind::Multiply: return "*";
+            case Kind::Divide: return "/";
+            case Kind::Equal: return "==";
+            case Kind::NotEqual: return "!=";
+            case Kind::Less: return "<";
+            case Kind::Greater: return ">";
+            case Kind::LessEqual: return "<=";
+            case Kind::GreaterEqual: return ">=";
+            default: return "?";
+        }
+    }
+
+    std::string describe(const Value& value) {
+        std::ostringstream os;
+        std::visit(
+            match {
+                [&](const String& s) { os << '"' << s << '"'; },
+                [&](char c) { os << '\'' << c << '\''; },
+                [&](const auto&) { os << value; },
+            },
+            value);
+        return os.str();
+    }
+
+    class Folder {
+    public:
+        Folder(expression::Tree& tree, Context& context, std::ostream* log, bool complete)
+            : mTree(tree), mContext(context), mLog(log), mComplete(complete) {}
+
+        void declare(expression::Index index) {
+            const auto& node = mTree[index];
+            if (node.kind == Kind::FunctionDeclaration) {
+                mDeclared.emplace(mTree.name(node.function.name));
+            }
+            expression::forEachChild(mTree, index, [&](expression::Index child) { declare(child); });
+        }
+
+        void fold(expression::Index index) {
+            bool function = mTree[index].kind == Kind::FunctionDeclaration;
+            mFunctionDepth += function;
+            expression::forEachChild(mTree, index, [&](expression::Index child) { fold(child); });
+            mFunctionDepth -= function;
+
+            std::optional<Value> value;
+            switch (mTree[index].kind) {
+                case Kind::Add:
+                case Kind::Subtract:
+                case Kind::Multiply:
+                case Kind::Divide:
+                case Kind::Equal:
+                case Kind::NotEqual:
+                case Kind::Less:
+                case Kind::Greater:
+                case Kind::LessEqual:
+                case Kind::GreaterEqual:
+                    value = binary(mTree[index]);
+                    break;
+                case Kind::FunctionCall:
+                    value = call(mTree[index].call);
+                    break;
+                default:
+                    return;
+            }
+            if (!value) {
+                return;
+            }
+
+            if (mLog) {
+                *mLog << "folded " << describe(index) << " -> " << describe(*value) << '\n';
+            }
+            // Узел заменяется на месте, его операнды просто остаются неиспользованными
+            mTree[index] = expression::Node(Kind::Constant, mTree.addConstant(std::move(*value)));
+            ++mFolded;
+        }
+
+        size_t folded() const { return mFolded; }
+
+    private:
+        expression::Tree& mTree;
+        Context& mContext;
+        std::ostream* mLog;
+        bool mComplete;
+        std::set<std::string, std::less<>> mDeclared;
+        size_t mFunctionDepth = 0;
+        size_t mFolded = 0;
+
+        /**
+         * @brief Source-like text of a node whose operands are already folded (for the log).
+         */
+        std::string describe(expression::Index index) const {
+            const auto& node = mTree[index];
+            switch (node.kind) {
+                case Kind::Constant:
+                    return describe(mTree.constant(node.operand));
+                case Kind::FunctionCall: {
+                    auto args = mTree[node.call.args];
+                    std::string result = std::string(mTree.name(node.call.name)) + "(";
+                    for (size_t i = 0; i < args.size(); ++i) {
+                        result += (i == 0 ? "" : ", ") + describe(args[i]);
+                    }
+                    return result + ")";
+                }
+                default:
+                    return describe(node.binary.lhs) + " " + symbol(node.kind) + " " + describe(node.binary.rhs);
+            }
+        }
+
+        static std::string describe(const Value& value) { return ::describe(value); }
+
+        const Value* constant(expression::Index index) const {
+            const auto& node = mTree[index];
+            return node.kind == Kind::Constant ? &mTree.constant(node.operand) : nullptr;
+        }
+
+        std::optional<Value> binary(const expression::Node& node) const {
+            auto* lhs = constant(node.binary.lhs);
+            auto* rhs = constant(node.binary.rhs);
+            if (!lhs || !rhs) {
+                return std::nullopt;
+            }
+            // Целочисленное деление на ноль оставляем до выполнения
+            bool integral = !std::holds_alternative<double>(*lhs) && !std::holds_alternative<double>(*rhs);
+            if (node.kind == Kind::Divide && integral && (*rhs == Value(0) || *rhs == Value('\0'))) {
+                return std::nullopt;
+            }
+
+            try {
+                switch (node.kind) {
+                    case Kind::Add: return operation::binary<std::plus<>>(*lhs, *rhs);
+                    case Kind::Subtract: return operation::binary<std::minus<>>(*lhs, *rhs);
+                    case Kind::Multiply: return operation::binary<std::multiplies<>>(*lhs, *rhs);
+                    case Kind::Divide: return operation::binary<std::divides<>>(*lhs, *rhs);
+                    case Kind::Equal: return operation::equal(*lhs, *rhs) ? 1 : 0;
+                    case Kind::NotEqual: return operation::equal(*lhs, *rhs) ? 0 : 1;
+                    case Kind::Less: return operation::binary<std::less<>>(*lhs, *rhs);
+                    case Kind::Greater: return operation::binary<std::greater<>>(*lhs, *rhs);
+                    case Kind::LessEqual: return operation::binary<std::less_equal<>>(*lhs, *rhs);
+                    case Kind::GreaterEqual: return operation::binary<std::greater_equal<>>(*lhs, *rhs);
+                    default: return std::nullopt;
+                }
+            } catch (const std::runtime_error&) {
+                return std::nullopt;
+            }
+        }
+
+        std::optional<Value> call(const expression::Call& node) {
+            auto name = mTree.name(node.name);
+            if (mDeclared.contains(name) || (!mComplete && mFunctionDepth > 0)) {
+                return std::nullopt;
+            }
+            const auto* function = mContext.functions.find(name);
+            if (!function || !function->pure || function->prototype) {
+                return std::nullopt;
+            }
+
+            std::vector<Value> args;
+            for (auto arg : mTree[node.args]) {
+                auto* value = constant(arg);
+                if (!value) {
+                    return std::nullopt;
+                }
+                args.push_back(*value);
+            }
+
+            try {
+                auto result = (*function)(mContext, std::move(args));
+                if (std::holds_alternative<ArrayRef>(result)) {
+                    return std::nullopt;
+                }
+                return result;
+            } catch (const std::exception&) {
+                return std::nullopt;
+            }
+        }
+    };
+}   // namespace
+
+size_t maxlang::optimizer::fold(expression::Tree& tree, expression::CommandSequence commands, Context& context, std::ostream* log,
+                                bool complete) {
+    Folder folder(tree, context, log, complete);
+    for (auto command : tree[commands]) {
+        folder.declare(command);
+    }
+    for (auto command : tree[commands]) {
+        folder.fold(command);
+    }
+    return folder.folded();
+}
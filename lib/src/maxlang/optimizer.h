@@ -0,0 +1,37 @@
+#pragma once
+
+#include <iosfwd>
+#include "context.h"
+#include "expression.h"
+
+/**
+ * @details
+ * AST passes that run between the Parser and the compiler. For example:
+ *
+ * ```
+ * x = 2 * 60 + Pow(2, 8);
+ * ```
+ *
+ * Is folded into:
+ * ```
+ * x = 376;
+ * ```
+ */
+namespace maxlang::optimizer {
+    /**
+     * @brief Replaces constant subexpressions with their values: operators applied to constants
+     * (including negative literals, which the lexer emits as `0 - n`) and calls of pure builtins
+     * with constant arguments. Expressions that would fail are left for the VM to report.
+     *
+     * Builtins are resolved against `context` at the time of the call, and are not folded if the
+     * commands declare a function with the same name. Folded nodes are replaced in place.
+     *
+     * @param log when not null, receives one line per folded expression.
+     * @param complete false if the commands are only a part of the program (see
+     * State::runStreaming): a later part may still shadow a builtin before a function body calls
+     * it, so builtin calls inside function bodies are not folded.
+     * @return number of folded expressions.
+     */
+    size_t fold(expression::Tree& tree, expression::CommandSequence commands, Context& context, std::ostream* log = nullptr,
+                bool complete = true);
+}
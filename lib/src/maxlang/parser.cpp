@@ -4,190 +4,218 @@
 #include "util.h"
 #include <stdexcept>
 #include <cassert>
+#include <optional>
+
+namespace {
+    /**
+     * @brief Returns the binary operator of `+=`, `-=`, `*=` and `/=`.
+     */
+    std::optional<maxlang::expression::Kind> compoundOperator(const maxlang::token::Any& token) {
+        using maxlang::expression::Kind;
+        return std::visit(
+            maxlang::match {
+                [](maxlang::token::PlusEqual) -> std::optional<Kind> { return Kind::Add; },
+                [](maxlang::token::MinusEqual) -> std::optional<Kind> { return Kind::Subtract; },
+                [](maxlang::token::AsteriskEqual) -> std::optional<Kind> { return Kind::Multiply; },
+                [](maxlang::token::SlashEqual) -> std::optional<Kind> { return Kind::Divide; },
+                [](const auto&) -> std::optional<Kind> { return std::nullopt; },
+            },
+            token);
+    }
+}
 
-std::unique_ptr<maxlang::expression::Base> maxlang::Parser::parseExpression(int leftBindingPower) {
-    if (mTokens.empty()) {
+maxlang::expression::Index maxlang::Parser::parseExpression(int leftBindingPower) {
+    if (atEnd()) {
         throw std::runtime_error("Unexpected end of input");
     }
 
     auto lhs = std::visit(
         match {
-          [](token::Integer token) -> std::unique_ptr<expression::Base> {
-              return std::make_unique<expression::Constant>(token.value);
+          [&](token::Integer token) -> expression::Index {
+              return constant(token.value);
           },
-          [](token::Float token) -> std::unique_ptr<expression::Base> {
-              return std::make_unique<expression::Constant>(token.value);
+          [&](token::Float token) -> expression::Index {
+              return constant(token.value);
           },
-          [](token::String token) -> std::unique_ptr<expression::Base> {
-              return std::make_unique<expression::Constant>(std::move(token.value));
+          [&](token::String token) -> expression::Index {
+              return constant(token.value);
           },
-          [](token::Char token) -> std::unique_ptr<expression::Base> {
-              return std::make_unique<expression::Constant>(token.value);
+          [&](token::Char token) -> expression::Index {
+              return constant(token.value);
           },
-          [&](token::LPar token) -> std::unique_ptr<expression::Base> {
+          [&](token::LPar token) -> expression::Index {
               auto lhs = parseExpression(0);
               auto n = take();
-              if (!std::holds_alternative<token::RPar>(n.first)) {
-                  throw std::runtime_error(fmt::format("Expected ')' to close '(', got {}, at line {}", tokenToString(n.first),n.second));
+              if (!n.is<token::RPar>()) {
+                  throw std::runtime_error(fmt::format("Expected ')' to close '(', got {}, at line {}", tokenToString(n.value()),n.line()));
               }
               return lhs;
           },
-          [&](token::Identifier identifier) -> std::unique_ptr<expression::Base> {
+          [&](token::Identifier identifier) -> expression::Index {
     // 1. variable reference
     // 2. function call
-    if (std::holds_alternative<token::LPar>(peek().first)) {
+    if (peek().is<token::LPar>()) {
         take();
-        std::vector<std::unique_ptr<expression::Base>> args;
+        auto args = mList.size();
         for (;;) {
             auto n = peek();
-            if (std::holds_alternative<token::RPar>(n.first)) {
+            if (n.is<token::RPar>()) {
                 take();
-                if (!args.empty()) {
-                    throw std::runtime_error(fmt::format("Unexpected ')' after ',', at line {}",n.second));
+                if (mList.size() != args) {
+                    throw std::runtime_error(fmt::format("Unexpected ')' after ',', at line {}",n.line()));
                 }
                 break;
             }
-            args.push_back(parseExpression());
-            if (std::holds_alternative<token::Comma>(peek().first)) {
+            mList.push_back(parseExpression());
+            if (peek().is<token::Comma>()) {
                 take();
                 continue;
             }
-            if (std::holds_alternative<token::RPar>(peek().first)) {
+            if (peek().is<token::RPar>()) {
                 take();
                 break;
             }
             throw std::runtime_error(
-                fmt::format("Expected ',' or ')' to close argument list, got {}, at line {}", typeid(n).name(),n.second));
+                fmt::format("Expected ',' or ')' to close argument list, got {}, at line {}", typeid(n).name(),n.line()));
         }
-        return std::make_unique<expression::FunctionCall>(std::move(identifier.value), std::move(args));
+        return mTree.add({ expression::Kind::FunctionCall, expression::Call { mTree.addName(identifier.value), finishList(args) } });
     }
 
-    auto variableRef = std::make_unique<expression::VariableReference>(std::move(identifier.value));
+    auto variableRef = mTree.add({ expression::Kind::VariableReference, expression::Variable { mTree.addName(identifier.value), expression::kNone } });
 
     // Проверяем индексацию массива
-    if (std::holds_alternative<token::LSquareBracket>(peek().first)) {
+    if (peek().is<token::LSquareBracket>()) {
     take();
 
     auto index = parseExpression();
 
-    if (mTokens.empty()) {
-        throw std::runtime_error(fmt::format("Unexpected end of input after array index",peek().second));
+    if (atEnd()) {
+        throw std::runtime_error(fmt::format("Unexpected end of input after array index",peek().line()));
     }
 
-    if (!std::holds_alternative<token::RSquareBracket>(peek().first)) {
+    if (!peek().is<token::RSquareBracket>()) {
         throw std::runtime_error(fmt::format("Expected ']' after array index, got {}, at line {}",
-            tokenToString(peek().first),peek().second));
+            tokenToString(peek().value()),peek().line()));
     }
     take();
 
-    return std::make_unique<expression::ArrayIndex>(std::move(variableRef), std::move(index));
+    return mTree.add({ expression::Kind::ArrayIndex, expression::Element { variableRef, index, expression::kNone } });
 }
 
     return variableRef;
 },
 
-            [&](token::LSquareBracket token) -> std::unique_ptr<expression::Base> {
-    std::vector<std::unique_ptr<expression::Base>> elements;
+            [&](token::LSquareBracket token) -> expression::Index {
+    auto elements = mList.size();
 
-    if (std::holds_alternative<token::RSquareBracket>(peek().first)) {
+    if (peek().is<token::RSquareBracket>()) {
         take();
-        return std::make_unique<expression::ArrayCreation>(std::move(elements), "");
+        return mTree.add({ expression::Kind::ArrayCreation, finishList(elements) });
     }
 
     while (true) {
-        elements.push_back(parseExpression());
+        mList.push_back(parseExpression());
 
-        if (mTokens.empty()) {
+        if (atEnd()) {
             throw std::runtime_error("Unexpected end of input in array literal");
         }
 
-        if (std::holds_alternative<token::RSquareBracket>(peek().first)) {
+        if (peek().is<token::RSquareBracket>()) {
             take();
             break;
         }
 
-        if (std::holds_alternative<token::Comma>(peek().first)) {
+        if (peek().is<token::Comma>()) {
             take();
             continue;
         }
 
         throw std::runtime_error(fmt::format("Expected ',' or ']' in array literal, got {}, at line {}",
-            tokenToString(peek().first),peek().second));
+            tokenToString(peek().value()),peek().line()));
     }
 
-    return std::make_unique<expression::ArrayCreation>(std::move(elements), "");
+    return mTree.add({ expression::Kind::ArrayCreation, finishList(elements) });
 },
 
-          [&](auto&& token) -> std::unique_ptr<expression::Base> {
-              throw std::runtime_error(fmt::format("Unexpected token: {}, at line {}", tokenToString(peek().first),peek().second));
+          [&](auto&& token) -> expression::Index {
+              throw std::runtime_error(fmt::format("Unexpected token: {}, at line {}", tokenToString(peek().value()),peek().line()));
           },
         },
-        take().first);
-    if (std::holds_alternative<token::LSquareBracket>(peek().first)) {
+        take().value());
+    if (peek().is<token::LSquareBracket>()) {
         take(); // consume '['
         auto index = parseExpression();
         auto n = take();
-        if (!std::holds_alternative<token::RSquareBracket>(n.first)) {
-            throw std::runtime_error(fmt::format("Expected ']' after index",n.second));
+        if (!n.is<token::RSquareBracket>()) {
+            throw std::runtime_error(fmt::format("Expected ']' after index",n.line()));
         }
 
         // Проверяем, является ли это присваиванием
-        if (std::holds_alternative<token::Equal>(peek().first)) {
+        if (peek().is<token::Equal>()) {
             take(); // consume '='
             auto value = parseExpression();
-            return std::make_unique<expression::ArrayAssignment>(
-                std::move(lhs), std::move(index), std::move(value));
+            return mTree.add({ expression::Kind::ArrayAssignment, expression::Element { lhs, index, value } });
         }
 
-        return std::make_unique<expression::ArrayIndex>(std::move(lhs), std::move(index));
+        return mTree.add({ expression::Kind::ArrayIndex, expression::Element { lhs, index, expression::kNone } });
     }
-    if (!mTokens.empty()) {
-        if (std::holds_alternative<token::PlusPlus>(peek().first)) {
+    if (!atEnd()) {
+        if (peek().is<token::PlusPlus>()) {
             take(); // consume '++'
-            lhs = std::make_unique<expression::PostfixIncrement>(std::move(lhs));
+            lhs = mTree.add({ expression::Kind::PostfixIncrement, lhs });
         }
-        if (std::holds_alternative<token::MinusMinus>(peek().first)) {
+        if (peek().is<token::MinusMinus>()) {
             take(); // consume '--'
-            lhs = std::make_unique<expression::PostfixDecrement>(std::move(lhs));
+            lhs = mTree.add({ expression::Kind::PostfixDecrement, lhs });
         }
     }
     for (;;) {
-        if (mTokens.empty()) {
+        if (atEnd()) {
             break;
         }
-        if (std::holds_alternative<token::RSquareBracket>(peek().first)) {
+        if (peek().is<token::RSquareBracket>()) {
             break;
         }
-        if (std::holds_alternative<token::RPar>(peek().first)) {
+        if (peek().is<token::RPar>()) {
             break;
         }
-        if (std::holds_alternative<token::Semicolon>(peek().first)) {
+        if (peek().is<token::Semicolon>()) {
             break;
         }
-        if (std::holds_alternative<token::Comma>(peek().first)) {
+        if (peek().is<token::Comma>()) {
             break;
         }
-        if (std::holds_alternative<token::Equal>(peek().first)) {
+        if (peek().is<token::RCurlyBracket>()) {
+            break;
+        }
+        if (peek().is<token::Equal>()) {
             take();
             auto rhs = parseExpression(0);
 
-            // Проверяем, является ли левая часть переменной
-            if (auto variableReference = dynamic_cast<expression::VariableReference*>(lhs.get())) {
-                lhs = std::make_unique<expression::VariableAssignment>(
-                    std::move(variableReference->name), std::move(rhs));
+            // Проверяем, является ли левая часть переменной (присваивание занимает место её узла)
+            if (mTree[lhs].kind == expression::Kind::VariableReference) {
+                mTree[lhs] = { expression::Kind::VariableAssignment, expression::Variable { mTree[lhs].variable.name, rhs } };
                 break;
             }
 
             // Проверяем, является ли левая часть доступом к массиву
-            if (auto arrayIndex = dynamic_cast<expression::ArrayIndex*>(lhs.get())) {
-                lhs = std::make_unique<expression::ArrayAssignment>(
-                    std::move(arrayIndex->array),
-                    std::move(arrayIndex->index),
-                    std::move(rhs));
+            if (mTree[lhs].kind == expression::Kind::ArrayIndex) {
+                mTree[lhs].kind = expression::Kind::ArrayAssignment;
+                mTree[lhs].element.value = rhs;
                 break;
             }
 
-            throw std::runtime_error(fmt::format("Expected variable or array element on left side of assignment, at line {}",peek().second));
+            throw std::runtime_error(fmt::format("Expected variable or array element on left side of assignment, at line {}",peek().line()));
+        }
+        if (auto op = compoundOperator(peek().value())) {
+            auto line = take().line();
+            auto target = mTree[lhs].kind;
+            if (target != expression::Kind::VariableReference && target != expression::Kind::ArrayIndex) {
+                throw std::runtime_error(fmt::format("Expected variable or array element on left side of assignment, at line {}", line));
+            }
+            auto rhs = parseExpression(0);
+            lhs = mTree.add({ expression::Kind::CompoundAssignment, expression::Compound { lhs, rhs, *op } });
+            break;
         }
 
         int rightBindingPower = std::visit(
@@ -204,10 +232,10 @@ std::unique_ptr<maxlang::expression::Base> maxlang::Parser::parseExpression(int
       [](token::Slash token) { return 2; },
       [](token::LSquareBracket token) { return 10; },
       [&](auto&& token) -> int {
-          throw std::runtime_error(fmt::format("Unexpected token: {}, at line {}", tokenToString(peek().first),peek().second));
+          throw std::runtime_error(fmt::format("Unexpected token: {}, at line {}", tokenToString(peek().value()),peek().line()));
       },
     },
-    peek().first);
+    peek().value());
 
         if (rightBindingPower < leftBindingPower) {
             return lhs;
@@ -218,113 +246,114 @@ auto rhs = parseExpression(rightBindingPower);
 
 lhs = std::visit(
     match {
-      [&](token::Equal2 token) -> std::unique_ptr<expression::Base> {
-          return std::make_unique<expression::Binary<std::equal_to<>>>(std::move(lhs), std::move(rhs));
+      [&](token::Equal2 token) -> expression::Index {
+          return binary<std::equal_to<>>(lhs, rhs);
       },
-        [&](token::NoEqual token) -> std::unique_ptr<expression::Base> {
-          return std::make_unique<expression::Binary<std::not_equal_to<>>>(std::move(lhs), std::move(rhs));
+        [&](token::NoEqual token) -> expression::Index {
+          return binary<std::not_equal_to<>>(lhs, rhs);
       },
-      [&](token::LAngleBracket token) -> std::unique_ptr<expression::Base> {          // <
-          return std::make_unique<expression::Binary<std::less<>>>(std::move(lhs), std::move(rhs));
+      [&](token::LAngleBracket token) -> expression::Index {          // <
+          return binary<std::less<>>(lhs, rhs);
       },
-      [&](token::RAngleBracket token) -> std::unique_ptr<expression::Base> {          // >
-          return std::make_unique<expression::Binary<std::greater<>>>(std::move(lhs), std::move(rhs));
+      [&](token::RAngleBracket token) -> expression::Index {          // >
+          return binary<std::greater<>>(lhs, rhs);
       },
-      [&](token::LAngleBracketEqual token) -> std::unique_ptr<expression::Base> {     // <=
-          return std::make_unique<expression::Binary<std::less_equal<>>>(std::move(lhs), std::move(rhs));
+      [&](token::LAngleBracketEqual token) -> expression::Index {     // <=
+          return binary<std::less_equal<>>(lhs, rhs);
       },
-      [&](token::RAngleBracketEqual token) -> std::unique_ptr<expression::Base> {     // >=
-          return std::make_unique<expression::Binary<std::greater_equal<>>>(std::move(lhs), std::move(rhs));
+      [&](token::RAngleBracketEqual token) -> expression::Index {     // >=
+          return binary<std::greater_equal<>>(lhs, rhs);
       },
-      [&](token::Plus token) -> std::unique_ptr<expression::Base> {
-          return std::make_unique<expression::Binary<std::plus<>>>(std::move(lhs), std::move(rhs));
+      [&](token::Plus token) -> expression::Index {
+          return binary<std::plus<>>(lhs, rhs);
       },
-      [&](token::Minus token) -> std::unique_ptr<expression::Base> {
-          return std::make_unique<expression::Binary<std::minus<>>>(std::move(lhs), std::move(rhs));
+      [&](token::Minus token) -> expression::Index {
+          return binary<std::minus<>>(lhs, rhs);
       },
-      [&](token::Asterisk token) -> std::unique_ptr<expression::Base> {
-          return std::make_unique<expression::Binary<std::multiplies<>>>(std::move(lhs), std::move(rhs));
+      [&](token::Asterisk token) -> expression::Index {
+          return binary<std::multiplies<>>(lhs, rhs);
       },
-      [&](token::Slash token) -> std::unique_ptr<expression::Base> {
-          return std::make_unique<expression::Binary<std::divides<>>>(std::move(lhs), std::move(rhs));
+      [&](token::Slash token) -> expression::Index {
+          return binary<std::divides<>>(lhs, rhs);
       },
-      [&](auto&& token) -> std::unique_ptr<expression::Base> {
-          throw std::runtime_error(fmt::format("Unexpected token: {}, at line {}", tokenToString(opToken.first),peek().second));
+      [&](auto&& token) -> expression::Index {
+          throw std::runtime_error(fmt::format("Unexpected token: {}, at line {}", tokenToString(opToken.value()),peek().line()));
       },
     },
-    opToken.first);
+    opToken.value());
     }
 
     return lhs;
 }
 
 maxlang::expression::CommandSequence maxlang::Parser::parseCommandSequence() {
-    std::vector<std::unique_ptr<expression::Base>> expressions;
+    auto expressions = mList.size();
+    for (auto statement = parseStatement(); statement != expression::kNone; statement = parseStatement()) {
+        mList.push_back(statement);
+    }
+    return finishList(expressions);
+}
 
-    while (!mTokens.empty()) {
+maxlang::expression::Index maxlang::Parser::parseStatement() {
+    while (!atEnd()) {
         auto current = peek();
 
         // Проверяем, является ли текущий токен ключевым словом
-        if (auto keyword = std::get_if<token::Keyword>(&current.first)) {
-            switch (*keyword) {
+        if (current.is<token::Keyword>()) {
+            switch (current.get<token::Keyword>()) {
                 case token::Keyword::IF:
-                    expressions.push_back(parseIfStatement());
-                    continue; // Уже обработали, переходим к следующему токену
+                    return parseIfStatement();
                 case token::Keyword::RETURN:
-                    expressions.push_back(parseReturnStatement());
-                    continue;
+                    return parseReturnStatement();
                 case token::Keyword::FOR:
-                    expressions.push_back(parseForStatement());
-                    continue;
+                    return parseForStatement();
                 case token::Keyword::WHILE:
-                    expressions.push_back(parseWhileStatement());
-                    continue;
+                    return parseWhileStatement();
                 case token::Keyword::FOREACH:
-                    expressions.push_back(parseForEachStatement());
-                    continue;
+                    return parseForEachStatement();
                 case token::Keyword::BREAK:
-                    expressions.push_back(std::make_unique<expression::Break>());
                     take();
-                    continue;
+                    return mTree.add(expression::Node(expression::Kind::Break));
                 case token::Keyword::CONTINUE:
-                    expressions.push_back(std::make_unique<expression::Continue>());
                     take();
-                    continue;
+                    return mTree.add(expression::Node(expression::Kind::Continue));
                 case token::Keyword::FN:
-                    expressions.push_back(parseFunctionDeclaration());
-                    continue;
+                    return parseFunctionDeclaration();
                 case token::Keyword::ELSE:
                     // Обработка else должна быть в parseIfStatement
                     break;
+                case token::Keyword::IN:
+                    // in встречается только внутри foreach
+                    break;
             }
         }
 
         // Если это не ключевое слово, парсим как выражение
-        if (std::holds_alternative<token::RCurlyBracket>(peek().first)) {
+        if (peek().is<token::RCurlyBracket>()) {
             break;
         }
-        if (std::holds_alternative<token::Semicolon>(peek().first)) {
+        if (peek().is<token::Semicolon>()) {
             take();
             continue;
         }
 
-        expressions.push_back(parseExpression());
+        return parseExpression();
     }
-    return expressions;
+    return expression::kNone;
 }
 
-std::unique_ptr<maxlang::expression::Base> maxlang::Parser::parseIfStatement() {
+maxlang::expression::Index maxlang::Parser::parseIfStatement() {
     // Убедимся, что это действительно IF
     auto ifToken = take();
-    if (!std::holds_alternative<token::Keyword>(ifToken.first) ||
-        std::get<token::Keyword>(ifToken.first) != token::Keyword::IF) {
+    if (!ifToken.is<token::Keyword>() ||
+        ifToken.get<token::Keyword>() != token::Keyword::IF) {
         throw std::runtime_error("Internal error: parseIfStatement called without IF token");
     }
 
     // Проверяем открывающую скобку с помощью peek
     auto lparToken = peek();
-    if (!std::holds_alternative<token::LPar>(lparToken.first)) {
-        throw std::runtime_error(fmt::format("Expected '(' after 'if', at line {}", lparToken.second));
+    if (!lparToken.is<token::LPar>()) {
+        throw std::runtime_error(fmt::format("Expected '(' after 'if', at line {}", lparToken.line()));
     }
     take(); // consume '('
 
@@ -333,97 +362,95 @@ std::unique_ptr<maxlang::expression::Base> maxlang::Parser::parseIfStatement() {
 
     // Проверяем закрывающую скобку
     auto rparToken = take();
-    if (!std::holds_alternative<token::RPar>(rparToken.first)) {
-        throw std::runtime_error(fmt::format("Expected ')' after condition, at line {}", rparToken.second));
+    if (!rparToken.is<token::RPar>()) {
+        throw std::runtime_error(fmt::format("Expected ')' after condition, at line {}", rparToken.line()));
     }
 
     // Проверяем открывающую фигурную скобку
     auto lcurlyToken = peek();
-    if (!std::holds_alternative<token::LCurlyBracket>(lcurlyToken.first)) {
-        throw std::runtime_error(fmt::format("Expected '{{' after ')', at line {}", lcurlyToken.second));
+    if (!lcurlyToken.is<token::LCurlyBracket>()) {
+        throw std::runtime_error(fmt::format("Expected '{{' after ')', at line {}", lcurlyToken.line()));
     }
 
     auto ifBody = parseCommandBlock();
 
     // Проверяем наличие else
-    if (!mTokens.empty() &&
-        std::holds_alternative<token::Keyword>(peek().first) &&
-        std::get<token::Keyword>(peek().first) == token::Keyword::ELSE) {
+    if (!atEnd() &&
+        peek().is<token::Keyword>() &&
+        peek().get<token::Keyword>() == token::Keyword::ELSE) {
 
         take(); // consume 'else'
 
-        if (!std::holds_alternative<token::LCurlyBracket>(peek().first)) {
-            throw std::runtime_error(fmt::format("Expected '{{' after 'else', at line {}", peek().second));
+        if (!peek().is<token::LCurlyBracket>()) {
+            throw std::runtime_error(fmt::format("Expected '{{' after 'else', at line {}", peek().line()));
         }
 
         auto elseBody = parseCommandBlock();
-        return std::make_unique<maxlang::expression::IfElse>(
-            std::move(condition), std::move(ifBody), std::move(elseBody));
+        return mTree.add({ expression::Kind::IfElse, expression::Branch { condition, ifBody, elseBody } });
     }
 
-    return std::make_unique<maxlang::expression::If>(std::move(condition), std::move(ifBody));
+    return mTree.add({ expression::Kind::If, expression::Branch { condition, ifBody, {} } });
 }
 
 
 maxlang::expression::CommandSequence maxlang::Parser::parseCommandBlock() {
     auto openBrace = take();
-    if (!std::holds_alternative<token::LCurlyBracket>(openBrace.first)) {
+    if (!openBrace.is<token::LCurlyBracket>()) {
         throw std::runtime_error(fmt::format("Expected '{{', got {}, at line {}",
-            tokenToString(openBrace.first), openBrace.second));
+            tokenToString(openBrace.value()), openBrace.line()));
     }
 
     auto result = parseCommandSequence();
 
-    if (mTokens.empty()) {
+    if (atEnd()) {
         throw std::runtime_error("Unexpected end of input in command block");
     }
 
     auto closeBrace = take();
-    if (!std::holds_alternative<token::RCurlyBracket>(closeBrace.first)) {
+    if (!closeBrace.is<token::RCurlyBracket>()) {
         throw std::runtime_error(fmt::format("Expected '}}' to close command block, got {}, at line {}",
-            tokenToString(closeBrace.first), closeBrace.second));
+            tokenToString(closeBrace.value()), closeBrace.line()));
     }
 
     return result;
 }
 
-std::unique_ptr<maxlang::expression::Return> maxlang::Parser::parseReturnStatement() {
-    assert(std::get<token::Keyword>(peek().first) == token::Keyword::RETURN);
+maxlang::expression::Index maxlang::Parser::parseReturnStatement() {
+    assert(peek().get<token::Keyword>() == token::Keyword::RETURN);
     take();
-    if (std::holds_alternative<token::Semicolon>(peek().first)) {
+    if (peek().is<token::Semicolon>()) {
         // return;
-        return std::make_unique<expression::Return>(nullptr);
+        return mTree.add({ expression::Kind::Return, expression::kNone });
     }
 
     // return 228;
-    return std::make_unique<expression::Return>(parseExpression());
+    return mTree.add({ expression::Kind::Return, parseExpression() });
 }
 
-std::unique_ptr<maxlang::expression::For> maxlang::Parser::parseForStatement() {
-    assert(std::get<token::Keyword>(peek().first) == token::Keyword::FOR);
+maxlang::expression::Index maxlang::Parser::parseForStatement() {
+    assert(peek().get<token::Keyword>() == token::Keyword::FOR);
     take(); // consume 'for'
     auto n = take();
-    if (!std::holds_alternative<token::LPar>(n.first)) {
-        throw std::runtime_error(fmt::format("Expected '(' after 'for', at line {}", n.second));
+    if (!n.is<token::LPar>()) {
+        throw std::runtime_error(fmt::format("Expected '(' after 'for', at line {}", n.line()));
     }
 
     // Парсим инициализацию (может быть пустой, объявление переменной или выражение)
-    std::unique_ptr<expression::Base> initialization = nullptr;
-    if (!std::holds_alternative<token::Semicolon>(peek().first)) {
+    auto initialization = expression::kNone;
+    if (!peek().is<token::Semicolon>()) {
         // Проверяем, является ли это объявлением переменной (типа "var i = 0")
-        if (std::holds_alternative<token::Identifier>(peek().first)) {
+        if (peek().is<token::Identifier>()) {
             auto identifierToken = peek();
-            std::string varName = std::get<token::Identifier>(identifierToken.first).value;
+            auto varName = mTree.addName(identifierToken.get<token::Identifier>().value);
 
             // Проверяем следующий токен - если это '=', то это объявление с инициализацией
-            auto nextToken = mTokens.size() > 1 ? mTokens[1] : std::pair<token::Any, int>{token::Semicolon{}, 0};
+            auto nextToken = peek(1);
 
-            if (std::holds_alternative<token::Equal>(nextToken.first)) {
+            if (nextToken.is<token::Equal>()) {
                 take(); // consume identifier
                 take(); // consume '='
                 auto initialValue = parseExpression();
-                initialization = std::make_unique<expression::VariableDeclaration>(
-                    std::move(varName), std::move(initialValue));
+                initialization = mTree.add({ expression::Kind::VariableDeclaration, expression::Variable { varName, initialValue } });
             } else {
                 // Просто использование существующей переменной
                 initialization = parseExpression();
@@ -435,68 +462,63 @@ std::unique_ptr<maxlang::expression::For> maxlang::Parser::parseForStatement() {
     }
 
     n = take();
-    if (!std::holds_alternative<token::Semicolon>(n.first)) {
-        throw std::runtime_error(fmt::format("Expected ';' after for initialization at line {}", n.second));
+    if (!n.is<token::Semicolon>()) {
+        throw std::runtime_error(fmt::format("Expected ';' after for initialization at line {}", n.line()));
     }
 
     // Остальная часть функции остается без изменений...
     // Парсим условие (может быть пустым)
-    std::unique_ptr<expression::Base> condition = nullptr;
-    if (!std::holds_alternative<token::Semicolon>(peek().first)) {
+    auto condition = expression::kNone;
+    if (!peek().is<token::Semicolon>()) {
         condition = parseExpression();
     }
     n = take();
-    if (!std::holds_alternative<token::Semicolon>(n.first)) {
-        throw std::runtime_error(fmt::format("Expected ';' after for condition, at line {}", n.second));
+    if (!n.is<token::Semicolon>()) {
+        throw std::runtime_error(fmt::format("Expected ';' after for condition, at line {}", n.line()));
     }
 
     // Парсим инкремент (может быть пустым)
-    std::unique_ptr<expression::Base> increment = nullptr;
-    if (!std::holds_alternative<token::RPar>(peek().first)) {
+    auto increment = expression::kNone;
+    if (!peek().is<token::RPar>()) {
         increment = parseExpression();
     }
     n = take();
-    if (!std::holds_alternative<token::RPar>(n.first)) {
-        throw std::runtime_error(fmt::format("Expected ')' after for increment, at line {}", n.second));
+    if (!n.is<token::RPar>()) {
+        throw std::runtime_error(fmt::format("Expected ')' after for increment, at line {}", n.line()));
     }
 
     // Парсим тело цикла
-    if (!std::holds_alternative<token::LCurlyBracket>(peek().first)) {
-        throw std::runtime_error(fmt::format("Expected '{}' after for statement", "{", peek().second));
+    if (!peek().is<token::LCurlyBracket>()) {
+        throw std::runtime_error(fmt::format("Expected '{}' after for statement", "{", peek().line()));
     }
     auto body = parseCommandBlock();
 
-    return std::make_unique<maxlang::expression::For>(
-        std::move(initialization),
-        std::move(condition),
-        std::move(increment),
-        std::move(body)
-    );
+    return mTree.add({ expression::Kind::For, expression::Loop { initialization, condition, increment, body } });
 }
 
-std::unique_ptr<maxlang::expression::While> maxlang::Parser::parseWhileStatement() {
-    assert(std::get<token::Keyword>(peek().first) == token::Keyword::WHILE);
+maxlang::expression::Index maxlang::Parser::parseWhileStatement() {
+    assert(peek().get<token::Keyword>() == token::Keyword::WHILE);
     take();
 
     // ИСПРАВЬТЕ ТАКЖЕ ЗДЕСЬ:
     auto n = peek();  // используем peek() вместо take()
-    if (!std::holds_alternative<token::LPar>(n.first)) {
-        throw std::runtime_error(fmt::format("Expected '(' after 'while', at line {}", n.second));
+    if (!n.is<token::LPar>()) {
+        throw std::runtime_error(fmt::format("Expected '(' after 'while', at line {}", n.line()));
     }
     take(); // consume '('
 
     auto condition = parseExpression();
 
     n = peek();  // используем peek() для проверки ')'
-    if (!std::holds_alternative<token::RPar>(n.first)) {
-        throw std::runtime_error(fmt::format("Expected ')' after condition, at line {}", n.second));
+    if (!n.is<token::RPar>()) {
+        throw std::runtime_error(fmt::format("Expected ')' after condition, at line {}", n.line()));
     }
     take();
-    if (!std::holds_alternative<token::LCurlyBracket>(peek().first)) {
-        throw std::runtime_error(fmt::format("Expected '{}' after ')', at line {}","{",peek().second));
+    if (!peek().is<token::LCurlyBracket>()) {
+        throw std::runtime_error(fmt::format("Expected '{}' after ')', at line {}","{",peek().line()));
     }
     auto body = parseCommandBlock();
-    return std::make_unique<maxlang::expression::While>(std::move(condition), std::move(body));
+    return mTree.add({ expression::Kind::While, expression::Branch { condition, body, {} } });
 }
 
 std::string maxlang::Parser::tokenToString(const maxlang::token::Any& token) {
@@ -513,6 +535,7 @@ std::string maxlang::Parser::tokenToString(const maxlang::token::Any& token) {
                     case maxlang::token::Keyword::FOREACH: return "foreach";
                     case maxlang::token::Keyword::BREAK: return "break";
                     case maxlang::token::Keyword::CONTINUE: return "continue";
+                    case maxlang::token::Keyword::IN: return "in";
                 }
                 return "unknown keyword";
             },
@@ -538,8 +561,12 @@ std::string maxlang::Parser::tokenToString(const maxlang::token::Any& token) {
             [](maxlang::token::RAngleBracketEqual)-> std::string  { return ">="; },
             [](maxlang::token::PlusPlus)-> std::string  { return "++"; },
             [](maxlang::token::MinusMinus)-> std::string  { return "--"; },
-            [](const maxlang::token::Identifier& id)-> std::string  { return "identifier:" + id.value; },
-            [](const maxlang::token::String& s)-> std::string  { return "string:\"" + s.value + "\""; },
+            [](maxlang::token::PlusEqual)-> std::string  { return "+="; },
+            [](maxlang::token::MinusEqual)-> std::string  { return "-="; },
+            [](maxlang::token::AsteriskEqual)-> std::string  { return "*="; },
+            [](maxlang::token::SlashEqual)-> std::string  { return "/="; },
+            [](const maxlang::token::Identifier& id)-> std::string  { return "identifier:" + std::string(id.value); },
+            [](const maxlang::token::String& s)-> std::string  { return "string:\"" + std::string(s.value) + "\""; },
             [](const maxlang::token::Char& c) -> std::string  { return "char:'" + std::string(1, c.value) + "'"; },
             [](const maxlang::token::Integer& i)-> std::string  { return "integer:" + std::to_string(i.value); },
             [](const maxlang::token::Float& f)-> std::string  { return "float:" + std::to_string(f.value); },
@@ -547,82 +574,78 @@ std::string maxlang::Parser::tokenToString(const maxlang::token::Any& token) {
         },
         token);
 }
-std::unique_ptr<maxlang::expression::ForEach> maxlang::Parser::parseForEachStatement() {
-    assert(std::get<token::Keyword>(peek().first) == token::Keyword::FOREACH);
+maxlang::expression::Index maxlang::Parser::parseForEachStatement() {
+    assert(peek().get<token::Keyword>() == token::Keyword::FOREACH);
     take(); // consume 'foreach'
     auto n = take();
-    if (!std::holds_alternative<token::LPar>(n.first)) {
-        throw std::runtime_error(fmt::format("Expected '(' after 'foreach', at line {}",n.second));
+    if (!n.is<token::LPar>()) {
+        throw std::runtime_error(fmt::format("Expected '(' after 'foreach', at line {}",n.line()));
     }
 
     // Парсим имя переменной
-    if (!std::holds_alternative<token::Identifier>(peek().first)) {
-        throw std::runtime_error(fmt::format("Expected variable name in foreach, at line {}",peek().second));
+    if (!peek().is<token::Identifier>()) {
+        throw std::runtime_error(fmt::format("Expected variable name in foreach, at line {}",peek().line()));
     }
-    std::string variableName = std::get<token::Identifier>(take().first).value;
+    auto variableName = mTree.addName(take().get<token::Identifier>().value);
 
-    if (!std::holds_alternative<token::Keyword>(peek().first) ||
-        std::get<token::Keyword>(peek().first) != token::Keyword::IN) {
-        throw std::runtime_error(fmt::format("Expected 'in' after variable name, at line {}",peek().second));
+    if (!peek().is<token::Keyword>() ||
+        peek().get<token::Keyword>() != token::Keyword::IN) {
+        throw std::runtime_error(fmt::format("Expected 'in' after variable name, at line {}",peek().line()));
         }
     take(); // consume 'in'
 
     // Парсим коллекцию (массив)
     auto collection = parseExpression();
 
-    if (!std::holds_alternative<token::RPar>(take().first)) {
-        throw std::runtime_error(fmt::format("Expected ')' after collection, at line {}",peek().second));
+    if (!take().is<token::RPar>()) {
+        throw std::runtime_error(fmt::format("Expected ')' after collection, at line {}",peek().line()));
     }
 
     // Парсим тело цикла
-    if (!std::holds_alternative<token::LCurlyBracket>(peek().first)) {
-        throw std::runtime_error(fmt::format("Expected '{}' after foreach statement, at line {}","{",peek().second));
+    if (!peek().is<token::LCurlyBracket>()) {
+        throw std::runtime_error(fmt::format("Expected '{}' after foreach statement, at line {}","{",peek().line()));
     }
     auto body = parseCommandBlock();
 
-    return std::make_unique<maxlang::expression::ForEach>(
-        std::move(variableName),
-        std::move(collection),
-        std::move(body)
-    );
+    return mTree.add({ expression::Kind::ForEach, expression::ForEach { variableName, collection, body } });
 }
-std::unique_ptr<maxlang::expression::FunctionDeclaration> maxlang::Parser::parseFunctionDeclaration() {
-    assert(std::get<token::Keyword>(peek().first) == token::Keyword::FN);
+maxlang::expression::Index maxlang::Parser::parseFunctionDeclaration() {
+    assert(peek().get<token::Keyword>() == token::Keyword::FN);
     take(); // consume 'function'
 
     // Парсим имя функции
-    if (!std::holds_alternative<token::Identifier>(peek().first)) {
-        throw std::runtime_error(fmt::format("Expected function name, at line {}",peek().second));
+    if (!peek().is<token::Identifier>()) {
+        throw std::runtime_error(fmt::format("Expected function name, at line {}",peek().line()));
     }
-    std::string functionName = std::get<token::Identifier>(take().first).value;
+    auto functionName = mTree.addName(take().get<token::Identifier>().value);
 
     auto n = take();
     // Парсим параметры
-    if (!std::holds_alternative<token::LPar>(n.first)) {
-        throw std::runtime_error(fmt::format("Expected '(' after function name, at line {}",n.second));
+    if (!n.is<token::LPar>()) {
+        throw std::runtime_error(fmt::format("Expected '(' after function name, at line {}",n.line()));
     }
 
-    std::vector<std::string> parameters;
-    while (!std::holds_alternative<token::RPar>(peek().first)) {
-        if (!std::holds_alternative<token::Identifier>(peek().first)) {
-            throw std::runtime_error(fmt::format("Expected parameter name, at line {}",peek().second));
+    auto parameters = mList.size();
+    while (!peek().is<token::RPar>()) {
+        if (!peek().is<token::Identifier>()) {
+            throw std::runtime_error(fmt::format("Expected parameter name, at line {}",peek().line()));
         }
-        parameters.push_back(std::get<token::Identifier>(take().first).value);
+        mList.push_back(mTree.addName(take().get<token::Identifier>().value));
 
-        if (std::holds_alternative<token::Comma>(peek().first)) {
+        if (peek().is<token::Comma>()) {
             take(); // consume ','
-        } else if (!std::holds_alternative<token::RPar>(peek().first)) {
-            throw std::runtime_error(fmt::format("Expected ',' or ')' in parameter list, at line {}",peek().second));
+        } else if (!peek().is<token::RPar>()) {
+            throw std::runtime_error(fmt::format("Expected ',' or ')' in parameter list, at line {}",peek().line()));
         }
     }
     take(); // consume ')'
+    auto parameterList = finishList(parameters);
 
     // Парсим тело функции
-    if (!std::holds_alternative<token::LCurlyBracket>(peek().first)) {
-        throw std::runtime_error(fmt::format("Expected '{}' after function parameters, at line {}","{",peek().second));
+    if (!peek().is<token::LCurlyBracket>()) {
+        throw std::runtime_error(fmt::format("Expected '{}' after function parameters, at line {}","{",peek().line()));
     }
     auto body = parseCommandBlock();
 
-    return std::make_unique<expression::FunctionDeclaration>(
-        std::move(functionName), std::move(parameters), std::move(body));
+    return mTree.add({ expression::Kind::FunctionDeclaration, expression::Function { functionName, parameterList, body } });
 }
\ No newline at end of file
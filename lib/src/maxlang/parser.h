@@ -3,43 +3,110 @@
 
 #include "maxlang/token.h"
 #include "expression.h"
-#include <memory>
+#include "lexer.h"
+#include <algorithm>
 #include <span>
+#include <stdexcept>
+#include <vector>
 
 namespace maxlang {
 
     class Parser {
     public:
-        explicit Parser(std::span<std::pair<token::Any,int>> tokens) : mTokens(tokens) {}
+        /**
+         * @brief Nodes are added to `tree`; the parse functions return their indices.
+         */
+        Parser(token::Stream& tokens, expression::Tree& tree) : mTokens(tokens), mTree(tree) {}
 
-        std::unique_ptr<maxlang::expression::Base> parseExpression() {
+        /**
+         * @brief Streaming parser: tokens are requested from `lexer` as they are needed and the
+         * ones of finished statements are dropped (see parseNextStatement).
+         */
+        Parser(lexer::Lexer& lexer, token::Stream& tokens, expression::Tree& tree) : mLexer(&lexer), mTokens(tokens), mTree(tree) {}
+
+        expression::Index parseExpression() {
             return parseExpression(0);
         }
 
-        std::vector<std::unique_ptr<expression::Base>> parseCommandSequence();
+        expression::CommandSequence parseCommandSequence();
+
+        /**
+         * @brief Parses the next top-level statement, first dropping the tokens already consumed.
+         * Returns kNone at the end of input (or at a stray '}', where parseCommandSequence stops too).
+         */
+        expression::Index parseNextStatement() {
+            mTokens.discard(mNext);
+            mNext = 0;
+            return parseStatement();
+        }
 
         std::string tokenToString(const token::Any & any);
 
     private:
-        std::span<std::pair<maxlang::token::Any,int>> mTokens;
+        lexer::Lexer* mLexer = nullptr;
+        token::Stream& mTokens;
+        size_t mNext = 0;
+        expression::Tree& mTree;
+        // Элементы всех недостроенных списков, вложенные списки лежат в конце
+        std::vector<expression::Index> mList;
+
+        expression::Index parseExpression(int leftBindingPower);
+
+        /**
+         * @brief Parses one command, skipping empty ones; kNone at '}' or at the end of input.
+         */
+        expression::Index parseStatement();
 
-        std::unique_ptr<maxlang::expression::Base> parseExpression(int leftBindingPower);
+        expression::Index constant(Value value) {
+            return mTree.add({ expression::Kind::Constant, mTree.addConstant(std::move(value)) });
+        }
+
+        template <typename Op>
+        expression::Index binary(expression::Index lhs, expression::Index rhs) {
+            return mTree.add({ expression::binaryKind<Op>(), expression::Binary { lhs, rhs } });
+        }
+
+        /**
+         * @brief Returns the next token; the end of input looks like a ';'.
+         */
+        token::Token peek(size_t ahead = 0) {
+            fill(mNext + ahead + 1);
+            return { mTokens, mNext + ahead };
+        }
 
-        const std::pair<token::Any,int> peek() const {
-            return mTokens.front();
+        bool atEnd() {
+            fill(mNext + 1);
+            return mNext == mTokens.size();
+        }
+
+        void fill(size_t size) {
+            if (mLexer && mTokens.size() < size) {
+                // Лексер вызывается пачками, чтобы не платить за вызов на каждый токен
+                mLexer->fill(mTokens, std::max(size, mTokens.size() + 64));
+            }
+        }
+
+        /**
+         * @brief Moves the elements pushed to mList since `start` into the tree.
+         */
+        expression::List finishList(size_t start) {
+            auto list = mTree.addList(std::span<const expression::Index>(mList).subspan(start));
+            mList.resize(start);
+            return list;
         }
 
-        std::pair<token::Any,int> take() {
-            auto token = std::move(mTokens.front());
-            mTokens = mTokens.subspan(1);
-            return token;
+        token::Token take() {
+            if (atEnd()) {
+                throw std::runtime_error("Unexpected end of input");
+            }
+            return { mTokens, mNext++ };
         }
-        std::unique_ptr<maxlang::expression::Base> parseIfStatement();
-        std::unique_ptr<maxlang::expression::Return> parseReturnStatement();
-        std::unique_ptr<maxlang::expression::For> parseForStatement();
-        std::unique_ptr<maxlang::expression::While> parseWhileStatement();
-        std::unique_ptr<maxlang::expression::ForEach> parseForEachStatement();
-        std::unique_ptr<maxlang::expression::FunctionDeclaration> parseFunctionDeclaration();
+        expression::Index parseIfStatement();
+        expression::Index parseReturnStatement();
+        expression::Index parseForStatement();
+        expression::Index parseWhileStatement();
+        expression::Index parseForEachStatement();
+        expression::Index parseFunctionDeclaration();
 
         /**
          * @brief Like parseCommandSequence but also consumes '{' and '}'.
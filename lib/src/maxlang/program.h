@@ -0,0 +1,22 @@
+#pragma once
+
+#include "bytecode.h"
+#include <memory>
+
+namespace maxlang {
+    /**
+     * @brief Compiled code returned by State::compile. It is immutable and cheap to copy, and can be
+     * run with State::execute or State::evaluate any number of times without parsing it again.
+     */
+    class Program {
+    public:
+        const bytecode::Chunk& chunk() const { return *mChunk; }
+
+    private:
+        friend class State;
+
+        explicit Program(bytecode::Chunk chunk) : mChunk(std::make_shared<const bytecode::Chunk>(std::move(chunk))) {}
+
+        std::shared_ptr<const bytecode::Chunk> mChunk;
+    };
+}
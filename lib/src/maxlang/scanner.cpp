@@ -0,0 +1,279 @@
+#include "scanner.h"
+#include "fmt/format.h"
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MAXLANG_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+using maxlang::lexer::scan::Isa;
+
+namespace {
+    bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+    bool isIdentifier(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+    }
+
+    const char* skipBlankScalar(const char* p, const char* end) {
+        while (p != end && isBlank(*p)) {
+            ++p;
+        }
+        return p;
+    }
+
+    const char* identifierEndScalar(const char* p, const char* end) {
+        while (p != end && isIdentifier(*p)) {
+            ++p;
+        }
+        return p;
+    }
+
+    const char* findScalar(const char* p, const char* end, char c) {
+        while (p != end && *p != c) {
+            ++p;
+        }
+        return p;
+    }
+
+    const char* commentEndScalar(const char* p, const char* end) {
+        for (; end - p >= 2; ++p) {
+            if (p[0] == '*' && p[1] == '/') {
+                return p;
+            }
+        }
+        return end;
+    }
+
+    int countLinesScalar(const char* p, const char* end) {
+        int lines = 0;
+        for (; p != end; ++p) {
+            lines += *p == '\n';
+        }
+        return lines;
+    }
+
+#ifdef MAXLANG_SCAN_X86
+    // Байты >= 0x80 при знаковом сравнении отрицательны и в диапазоны ASCII не попадают
+    __m128i inRange(__m128i x, char lo, char hi) {
+        return _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8(static_cast<char>(lo - 1))),
+                             _mm_cmplt_epi8(x, _mm_set1_epi8(static_cast<char>(hi + 1))));
+    }
+
+    const char* skipBlankSSE2(const char* p, const char* end) {
+        for (; end - p >= 16; p += 16) {
+            auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            auto blank = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(x, _mm_set1_epi8(' '))),
+                                      _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\t')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\r'))));
+            auto other = ~static_cast<uint32_t>(_mm_movemask_epi8(blank)) & 0xFFFF;
+            if (other) {
+                return p + std::countr_zero(other);
+            }
+        }
+        return skipBlankScalar(p, end);
+    }
+
+    const char* identifierEndSSE2(const char* p, const char* end) {
+        for (; end - p >= 16; p += 16) {
+            auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            auto letter = inRange(_mm_or_si128(x, _mm_set1_epi8(0x20)), 'a', 'z');
+            auto digit = inRange(x, '0', '9');
+            auto underscore = _mm_cmpeq_epi8(x, _mm_set1_epi8('_'));
+            auto identifier = _mm_or_si128(_mm_or_si128(letter, digit), underscore);
+            auto other = ~static_cast<uint32_t>(_mm_movemask_epi8(identifier)) & 0xFFFF;
+            if (other) {
+                return p + std::countr_zero(other);
+            }
+        }
+        return identifierEndScalar(p, end);
+    }
+
+    const char* findSSE2(const char* p, const char* end, char c) {
+        for (; end - p >= 16; p += 16) {
+            auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            auto found = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8(c))));
+            if (found) {
+                return p + std::countr_zero(found);
+            }
+        }
+        return findScalar(p, end, c);
+    }
+
+    // '*' и '/' сравниваются в двух векторах со сдвигом на байт
+    const char* commentEndSSE2(const char* p, const char* end) {
+        for (; end - p >= 17; p += 16) {
+            auto star = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), _mm_set1_epi8('*'));
+            auto slash = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1)), _mm_set1_epi8('/'));
+            auto found = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(star, slash)));
+            if (found) {
+                return p + std::countr_zero(found);
+            }
+        }
+        return commentEndScalar(p, end);
+    }
+
+    int countLinesSSE2(const char* p, const char* end) {
+        int lines = 0;
+        for (; end - p >= 16; p += 16) {
+            auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            lines += std::popcount(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8('\n')))));
+        }
+        return lines + countLinesScalar(p, end);
+    }
+
+#define MAXLANG_AVX2 __attribute__((target("avx2")))
+
+    MAXLANG_AVX2 __m256i inRange256(__m256i x, char lo, char hi) {
+        return _mm256_and_si256(_mm256_cmpgt_epi8(x, _mm256_set1_epi8(static_cast<char>(lo - 1))),
+                                _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(hi + 1)), x));
+    }
+
+    MAXLANG_AVX2 const char* skipBlankAVX2(const char* p, const char* end) {
+        for (; end - p >= 32; p += 32) {
+            auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            auto blank = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8(' '))),
+                                         _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\t')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\r'))));
+            auto other = ~static_cast<uint32_t>(_mm256_movemask_epi8(blank));
+            if (other) {
+                return p + std::countr_zero(other);
+            }
+        }
+        return skipBlankSSE2(p, end);
+    }
+
+    MAXLANG_AVX2 const char* identifierEndAVX2(const char* p, const char* end) {
+        for (; end - p >= 32; p += 32) {
+            auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            auto letter = inRange256(_mm256_or_si256(x, _mm256_set1_epi8(0x20)), 'a', 'z');
+            auto digit = inRange256(x, '0', '9');
+            auto underscore = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('_'));
+            auto identifier = _mm256_or_si256(_mm256_or_si256(letter, digit), underscore);
+            auto other = ~static_cast<uint32_t>(_mm256_movemask_epi8(identifier));
+            if (other) {
+                return p + std::countr_zero(other);
+            }
+        }
+        return identifierEndSSE2(p, end);
+    }
+
+    MAXLANG_AVX2 const char* findAVX2(const char* p, const char* end, char c) {
+        for (; end - p >= 32; p += 32) {
+            auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            auto found = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(c))));
+            if (found) {
+                return p + std::countr_zero(found);
+            }
+        }
+        return findSSE2(p, end, c);
+    }
+
+    MAXLANG_AVX2 const char* commentEndAVX2(const char* p, const char* end) {
+        for (; end - p >= 33; p += 32) {
+            auto star = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), _mm256_set1_epi8('*'));
+            auto slash = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1)), _mm256_set1_epi8('/'));
+            auto found = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(star, slash)));
+            if (found) {
+                return p + std::countr_zero(found);
+            }
+        }
+        return commentEndSSE2(p, end);
+    }
+
+    MAXLANG_AVX2 int countLinesAVX2(const char* p, const char* end) {
+        int lines = 0;
+        for (; end - p >= 32; p += 32) {
+            auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            lines += std::popcount(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')))));
+        }
+        return lines + countLinesSSE2(p, end);
+    }
+#endif
+
+    struct Kernels {
+        Isa isa;
+        const char* (*skipBlank)(const char*, const char*);
+        const char* (*identifierEnd)(const char*, const char*);
+        const char* (*find)(const char*, const char*, char);
+        const char* (*commentEnd)(const char*, const char*);
+        int (*countLines)(const char*, const char*);
+    };
+
+    const Kernels kScalar { Isa::Scalar, skipBlankScalar, identifierEndScalar, findScalar, commentEndScalar, countLinesScalar };
+#ifdef MAXLANG_SCAN_X86
+    const Kernels kSSE2 { Isa::SSE2, skipBlankSSE2, identifierEndSSE2, findSSE2, commentEndSSE2, countLinesSSE2 };
+    const Kernels kAVX2 { Isa::AVX2, skipBlankAVX2, identifierEndAVX2, findAVX2, commentEndAVX2, countLinesAVX2 };
+#endif
+
+    const Kernels& kernels(Isa isa) {
+        switch (isa) {
+#ifdef MAXLANG_SCAN_X86
+            case Isa::AVX2: return kAVX2;
+            case Isa::SSE2: return kSSE2;
+#endif
+            default: return kScalar;
+        }
+    }
+
+    Isa detect() {
+#ifdef MAXLANG_SCAN_X86
+        // SSE2 входит в базовый набор x86-64
+        return __builtin_cpu_supports("avx2") ? Isa::AVX2 : Isa::SSE2;
+#else
+        return Isa::Scalar;
+#endif
+    }
+
+    std::atomic<const Kernels*>& current() {
+        static std::atomic<const Kernels*> selected { &kernels(detect()) };
+        return selected;
+    }
+}   // namespace
+
+Isa maxlang::lexer::scan::best() {
+    static const Isa isa = detect();
+    return isa;
+}
+
+Isa maxlang::lexer::scan::active() {
+    return current().load(std::memory_order_relaxed)->isa;
+}
+
+void maxlang::lexer::scan::use(Isa isa) {
+    if (isa > best()) {
+        throw std::runtime_error(fmt::format("{} is not supported by this CPU", name(isa)));
+    }
+    current().store(&kernels(isa), std::memory_order_relaxed);
+}
+
+const char* maxlang::lexer::scan::name(Isa isa) {
+    switch (isa) {
+        case Isa::Scalar: return "scalar";
+        case Isa::SSE2: return "SSE2";
+        case Isa::AVX2: return "AVX2";
+    }
+    return "unknown";
+}
+
+const char* maxlang::lexer::scan::skipBlank(const char* begin, const char* end) {
+    return current().load(std::memory_order_relaxed)->skipBlank(begin, end);
+}
+
+const char* maxlang::lexer::scan::identifierEnd(const char* begin, const char* end) {
+    return current().load(std::memory_order_relaxed)->identifierEnd(begin, end);
+}
+
+const char* maxlang::lexer::scan::find(const char* begin, const char* end, char c) {
+    return current().load(std::memory_order_relaxed)->find(begin, end, c);
+}
+
+const char* maxlang::lexer::scan::commentEnd(const char* begin, const char* end) {
+    return current().load(std::memory_order_relaxed)->commentEnd(begin, end);
+}
+
+int maxlang::lexer::scan::countLines(const char* begin, const char* end) {
+    return current().load(std::memory_order_relaxed)->countLines(begin, end);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * @details
+ * Byte-scanning kernels used by the lexer. On x86-64 they classify 16 (SSE2) or 32 (AVX2) bytes
+ * at a time; the best instruction set is selected at startup, other platforms use plain loops.
+ * All variants return the same results.
+ */
+namespace maxlang::lexer::scan {
+    enum class Isa {
+        Scalar,
+        SSE2,
+        AVX2,
+    };
+
+    /**
+     * @brief The fastest instruction set this CPU supports.
+     */
+    Isa best();
+
+    /**
+     * @brief The instruction set the kernels currently use.
+     */
+    Isa active();
+
+    /**
+     * @brief Switches the kernels to `isa` (for benchmarks and tests); throws if the CPU does not
+     * support it.
+     */
+    void use(Isa isa);
+
+    const char* name(Isa isa);
+
+    /**
+     * @brief Skips spaces, tabs, '\r' and '\n'.
+     */
+    const char* skipBlank(const char* begin, const char* end);
+
+    /**
+     * @brief Returns the first byte that is not a letter, digit or '_'.
+     */
+    const char* identifierEnd(const char* begin, const char* end);
+
+    /**
+     * @brief Returns the first `c` in [begin, end), or `end`: the end of a line comment or of
+     * a string literal.
+     */
+    const char* find(const char* begin, const char* end, char c);
+
+    /**
+     * @brief Returns the `*` of the first `*` `/` pair in [begin, end), or `end`.
+     */
+    const char* commentEnd(const char* begin, const char* end);
+
+    /**
+     * @brief Number of '\n' in [begin, end); token lines are computed with it on demand.
+     */
+    int countLines(const char* begin, const char* end);
+}
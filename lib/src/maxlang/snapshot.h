@@ -0,0 +1,20 @@
+#pragma once
+
+#include "context.h"
+#include <memory>
+
+namespace maxlang {
+    /**
+     * @brief Frozen copy of a State returned by State::snapshot: functions, variables and the arrays
+     * they reference. It is immutable and cheap to copy; any number of threads can fork States from
+     * one snapshot at the same time.
+     */
+    class Snapshot {
+    private:
+        friend class State;
+
+        explicit Snapshot(std::shared_ptr<const Context> context) : mContext(std::move(context)) {}
+
+        std::shared_ptr<const Context> mContext;
+    };
+}
@@ -1,17 +1,200 @@
 #include "state.h"
+#include "cache.h"
 #include "lexer.h"
 #include "parser.h"
+#include "compiler.h"
+#include "optimizer.h"
+#include "vm.h"
+#include "fmt/format.h"
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <unordered_map>
 
 using namespace maxlang;
 
+namespace {
+    /**
+     * @brief Whether the statement can end the whole program: a `return` outside of functions or
+     * a `break` outside of loops (see compiler.cpp).
+     */
+    bool returns(const expression::Tree& tree, expression::Index index, bool inLoop = false) {
+        using expression::Kind;
+        auto kind = tree[index].kind;
+        if (kind == Kind::Return || (kind == Kind::Break && !inLoop)) {
+            return true;
+        }
+        bool result = false;
+        if (kind != Kind::FunctionDeclaration) {
+            bool loop = inLoop || kind == Kind::While || kind == Kind::For || kind == Kind::ForEach;
+            expression::forEachChild(tree, index, [&](expression::Index child) { result = result || returns(tree, child, loop); });
+        }
+        return result;
+    }
+
+    /**
+     * @brief Copies the tables of `source` into the empty context `target`. Arrays are copied into the new
+     * context's heap, so it can change them freely; arrays referenced from several places stay
+     * shared inside the copy, cycles included. `source` is only read: the ArrayRefs it holds are
+     * not copied, so a snapshot can be forked by several threads at once.
+     */
+    void copy(const Context& source, Context& target) {
+        target.functions = source.functions;
+        target.variables.setLibrary(source.variables.library());
+        if (source.memo) {
+            target.memo.emplace(source.memo->capacity());
+        }
+
+        std::unordered_map<const Array*, ArrayRef> copies;
+        std::vector<std::pair<const Array*, Array*>> pending;
+        auto map = [&](const Value& value) -> Value {
+            const auto* array = std::get_if<ArrayRef>(&value);
+            if (!array) {
+                return value;
+            }
+            auto& result = copies[array->get()];
+            if (!result.get()) {
+                result = target.heap().make({});
+                result->name = (*array)->name;
+                pending.emplace_back(array->get(), result.get());
+            }
+            return result;
+        };
+
+        source.variables.forEach([&](const std::string& name, const Value& value) { target.variables[name] = map(value); });
+        while (!pending.empty()) {
+            auto [from, to] = pending.back();
+            pending.pop_back();
+            to->elements.reserve(from->elements.size());
+            for (const auto& element : from->elements) {
+                to->elements.push_back(map(element));
+            }
+        }
+    }
+
+    /**
+     * @brief Parses `code` one top-level statement at a time and passes the compiled chunk of each
+     * to `execute` before parsing the next one.
+     */
+    template <typename F>
+    void stream(std::string_view code, Context& context, std::ostream* foldingLog, F&& execute) {
+        lexer::Lexer lexer(code);
+        token::Stream tokens(code);
+        expression::Tree tree;
+        Parser parser(lexer, tokens, tree);
+
+        for (;;) {
+            tree.clear();
+            auto statement = parser.parseNextStatement();
+            if (statement == expression::kNone) {
+                return;
+            }
+
+            std::vector<expression::Index> commands { statement };
+            bool last = returns(tree, statement);
+            if (last) {
+                // После return программа не продолжается, поэтому остаток компилируется вместе с ним
+                auto rest = parser.parseCommandSequence();
+                commands.insert(commands.end(), tree[rest].begin(), tree[rest].end());
+            }
+            auto list = tree.addList(commands);
+            // Следующие команды ещё могут перекрыть встроенные функции, вызываемые из тел функций
+            optimizer::fold(tree, list, context, foldingLog, false);
+            execute(compiler::compile(tree, list));
+            if (last) {
+                return;
+            }
+        }
+    }
+}
+
+State::State(const Snapshot& snapshot) {
+    copy(*snapshot.mContext, mContext);
+}
+
+Snapshot State::snapshot() const {
+    auto context = std::make_shared<Context>();
+    copy(mContext, *context);
+    return Snapshot(std::move(context));
+}
+
+State State::fork() const {
+    State result;
+    copy(mContext, result.mContext);
+    result.mFoldingLog = mFoldingLog;
+    return result;
+}
+
 maxlang::Value State::evaluate(std::string_view expression) {
-    auto tokens = lexer::process(expression);
-    Parser parser(tokens);
-    return parser.parseExpression()->evaluate(mContext);
+    return evaluate(compile(expression));
 }
 
 void State::run(std::string_view code) {
+    execute(compile(code));
+}
+
+Program State::compile(std::string_view code) {
     auto tokens = lexer::process(code);
-    Parser parser(tokens);
-    expression::execute(parser.parseCommandSequence(), mContext);
+    // Дерево целиком освобождается, как только код скомпилирован
+    expression::Tree tree;
+    Parser parser(tokens, tree);
+    auto commands = parser.parseCommandSequence();
+    optimizer::fold(tree, commands, mContext, mFoldingLog);
+    return Program(compiler::compile(tree, commands));
+}
+
+void State::execute(const Program& program) {
+    vm::run(program.chunk(), mContext);
+}
+
+maxlang::Value State::evaluate(const Program& program) {
+    return vm::run(program.chunk(), mContext);
+}
+
+void State::runStreaming(std::string_view code) {
+    stream(code, mContext, mFoldingLog, [&](const bytecode::Chunk& chunk) { vm::run(chunk, mContext); });
 }
+
+void State::runCached(std::string_view code, const std::filesystem::path& cachePath) {
+    auto sourceHash = cache::key(code, mContext.functions.library());
+    if (std::ifstream input(cachePath, std::ios::binary); input) {
+        std::string data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        if (auto chunks = cache::load(data, sourceHash)) {
+            for (const auto& chunk : *chunks) {
+                vm::run(chunk, mContext);
+            }
+            return;
+        }
+    }
+
+    std::vector<bytecode::Chunk> chunks;
+    stream(code, mContext, mFoldingLog, [&](bytecode::Chunk chunk) {
+        vm::run(chunk, mContext);
+        chunks.push_back(std::move(chunk));
+    });
+
+    // Кэш не обязателен: если его не удалось записать, в следующий раз программа просто скомпилируется заново
+    std::string data;
+    try {
+        data = cache::save(chunks, sourceHash);
+    } catch (const std::runtime_error&) {
+        return;
+    }
+    // У каждого писателя свой временный файл, иначе два процесса пишут в один и тот же
+    std::random_device random;
+    auto temporary = cachePath;
+    temporary += fmt::format(".{:08x}{:08x}.tmp", random(), random());
+    bool written = false;
+    {
+        std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
+        written = static_cast<bool>(output.write(data.data(), static_cast<std::streamsize>(data.size())));
+    }
+    // Файл подменяется целиком, чтобы параллельный запуск не прочитал его наполовину записанным
+    std::error_code error;
+    if (written) {
+        std::filesystem::rename(temporary, cachePath, error);
+    }
+    if (!written || error) {
+        std::filesystem::remove(temporary, error);
+    }
+}
\ No newline at end of file
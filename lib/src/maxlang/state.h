@@ -1,19 +1,86 @@
 #pragma once
 
 #include "value.h"
-#include "expression.h"
+#include "context.h"
+#include "native.h"
+#include "program.h"
+#include "snapshot.h"
 #include <any>
+#include <filesystem>
+#include <iosfwd>
 #include <string_view>
 
 namespace maxlang {
     class State {
     public:
+        State() = default;
+
+        /**
+         * @brief Starts from the functions, variables and arrays of `snapshot`. Changes made by this
+         * State are not visible to the snapshot or to other States forked from it.
+         */
+        explicit State(const Snapshot& snapshot);
+
+        /**
+         * @brief Freezes the current functions, variables and arrays, e.g. after stdlib::init and
+         * a prelude script, so that isolated States can be forked from them without running it again.
+         */
+        Snapshot snapshot() const;
+
+        /**
+         * @brief A new State with a copy of this one, same as State(snapshot()) but without the
+         * intermediate copy.
+         */
+        State fork() const;
+
         Value evaluate(std::string_view expression);
         void run(std::string_view code);
 
+        /**
+         * @brief Parses and compiles `code` once; variables are looked up when the program runs.
+         */
+        Program compile(std::string_view code);
+
+        void execute(const Program& program);
+
+        /**
+         * @brief Runs `program` and returns the value of its last expression statement.
+         */
+        Value evaluate(const Program& program);
+
+        /**
+         * @brief Like run, but executes every top-level statement as soon as it is parsed, so long
+         * scripts start working immediately and only the current statement is kept in memory.
+         * Statements before a syntax error have already run when it is reported.
+         */
+        void runStreaming(std::string_view code);
+
+        /**
+         * @brief Like runStreaming, but if `cachePath` holds the program compiled from the same
+         * source (see cache.h), runs it without parsing; otherwise compiles the source and stores
+         * the result there. A cache that cannot be read or written is ignored.
+         */
+        void runCached(std::string_view code, const std::filesystem::path& cachePath);
+
+        /**
+         * @brief Defines `name` as a typed C++ function (see native.h), e.g.
+         * `state.bind("Pow", +[](double a, double b) { return std::pow(a, b); }, true)`.
+         * `pure` has the same meaning as Function::pure.
+         */
+        template <typename F>
+        void bind(const std::string& name, F function, bool pure = false) {
+            mContext.functions[name] = native::wrap(+function, pure);
+        }
+
         Context& context() { return mContext; }
 
+        /**
+         * @brief Enables reporting of constant folding (see optimizer.h) to `log`; nullptr disables it.
+         */
+        void setFoldingLog(std::ostream* log) { mFoldingLog = log; }
+
     private:
         Context mContext;
+        std::ostream* mFoldingLog = nullptr;
     };
 }
\ No newline at end of file
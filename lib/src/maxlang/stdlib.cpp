@@ -8,7 +8,12 @@
     #include <windows.h>
 #endif
 #include <random>
+#include <sstream>
 
+#include "array.h"
+#include "fmt/format.h"
+#include "library.h"
+#include "native.h"
 #include "value.h"
 #include "util.h"
 
@@ -93,8 +98,8 @@ namespace {
         }
         return std::visit(
             maxlang::match {
-                [](const std::string& s) -> int {
-                    return std::stoi(s);
+                [](const String& s) -> int {
+                    return std::stoi(s.str());
                 },
                 [](const char& c) -> int {
                     return std::stoi(std::to_string(c)) - 48;
@@ -104,6 +109,7 @@ namespace {
                     return getIntFromValue(Round(state,V));
                 },
                 [](std::monostate) -> int { throw std::runtime_error("toint: can't convert void to int"); },
+                [](const ArrayRef&) -> int { throw std::runtime_error("toint: can't convert array to int"); },
                 [](auto&& v) -> int { return int(v); },
             },
             args[0]);
@@ -115,14 +121,15 @@ namespace {
         }
         return std::visit(
             maxlang::match {
-                [](const std::string& s) -> double {
-                    return std::stod(s);
+                [](const String& s) -> double {
+                    return std::stod(s.str());
                 },
                 [](const char& c) -> double {
                     return static_cast<double>(c);
                 },
                 [](int v) -> double { return static_cast<double>(v); },
                 [](std::monostate) -> double { throw std::runtime_error("todouble: can't convert void to double"); },
+                [](const ArrayRef&) -> double { throw std::runtime_error("todouble: can't convert array to double"); },
                 [](auto&& v) -> double { return static_cast<double>(v); },
             },
             args[0]);
@@ -134,137 +141,76 @@ namespace {
         }
         return std::visit(
             maxlang::match {
-                [](const std::string& s) -> std::string {
+                [](const String& s) -> String {
                     return s;
                 },
-                [](char c) -> std::string {
+                [](char c) -> String {
                     return std::to_string(c);
                 },
-                [](int v) -> std::string { return std::to_string(v); },
-                [](double v) -> std::string { return std::to_string(v); },
-                [](std::monostate) -> std::string { return "<void>"; },
+                [](int v) -> String { return std::to_string(v); },
+                [](double v) -> String { return std::to_string(v); },
+                [](std::monostate) -> String { return "<void>"; },
+                [](const ArrayRef& array) -> String {
+                    std::ostringstream os;
+                    os << array;
+                    return os.str();
+                },
             },
             args[0]);
     }
 
-    maxlang::Value array_length(maxlang::Context& state, const std::vector<maxlang::Value>& args) {
-    if (args.size() != 1) {
-        throw std::runtime_error("array_length expects 1 argument");
-    }
-
-    // Получаем имя массива из переменной или напрямую
-    std::string arrayName;
-    if (std::holds_alternative<std::string>(args[0])) {
-        arrayName = std::get<std::string>(args[0]);
-    } else {
-        auto varName = toString(state, {args[0]});
-        if (std::holds_alternative<std::string>(varName)) {
-            arrayName = std::get<std::string>(varName);
-        } else {
-            throw std::runtime_error("array_length: expected array name (string)");
+    Array& arrayArgument(const Value& value, const char* function) {
+        if (!std::holds_alternative<ArrayRef>(value)) {
+            throw std::runtime_error(fmt::format("{}: expected array", function));
         }
+        return *std::get<ArrayRef>(value);
     }
 
-    auto it = state.arrays.find(arrayName);
-    if (it == state.arrays.end()) {
-        throw std::runtime_error("Array not found: " + arrayName);
-    }
-
-    return static_cast<int>(it->second->elements.size());
-}
-
-maxlang::Value array_push(maxlang::Context& state, const std::vector<maxlang::Value>& args) {
-    if (args.size() < 2) {
-        throw std::runtime_error("array_push expects at least 2 arguments");
-    }
-
-    // Получаем имя массива из переменной или напрямую
-    std::string arrayName;
-    if (std::holds_alternative<std::string>(args[0])) {
-        arrayName = std::get<std::string>(args[0]);
-    } else {
-        auto varName = toString(state, {args[0]});
-        if (std::holds_alternative<std::string>(varName)) {
-            arrayName = std::get<std::string>(varName);
-        } else {
-            throw std::runtime_error("array_push: expected array name (string) as first argument");
+    maxlang::Value array_length(maxlang::Context& state, const std::vector<maxlang::Value>& args) {
+        if (args.size() != 1) {
+            throw std::runtime_error("array_length expects 1 argument");
         }
-    }
 
-    auto it = state.arrays.find(arrayName);
-    if (it == state.arrays.end()) {
-        throw std::runtime_error("Array not found: " + arrayName);
+        return static_cast<int>(arrayArgument(args[0], "array_length").elements.size());
     }
 
-    for (size_t i = 1; i < args.size(); ++i) {
-        it->second->elements.push_back(args[i]);
-    }
-
-    return static_cast<int>(it->second->elements.size());
-}
+    maxlang::Value array_push(maxlang::Context& state, const std::vector<maxlang::Value>& args) {
+        if (args.size() < 2) {
+            throw std::runtime_error("array_push expects at least 2 arguments");
+        }
 
-maxlang::Value array_pop(maxlang::Context& state, const std::vector<maxlang::Value>& args) {
-    if (args.size() != 1) {
-        throw std::runtime_error("array_pop expects 1 argument");
+        auto& array = arrayArgument(args[0], "array_push");
+        array.elements.insert(array.elements.end(), args.begin() + 1, args.end());
+        return static_cast<int>(array.elements.size());
     }
 
-    // Получаем имя массива из переменной или напрямую
-    std::string arrayName;
-    if (std::holds_alternative<std::string>(args[0])) {
-        arrayName = std::get<std::string>(args[0]);
-    } else {
-        auto varName = toString(state, {args[0]});
-        if (std::holds_alternative<std::string>(varName)) {
-            arrayName = std::get<std::string>(varName);
-        } else {
-            throw std::runtime_error("array_pop: expected array name (string)");
+    maxlang::Value array_pop(maxlang::Context& state, const std::vector<maxlang::Value>& args) {
+        if (args.size() != 1) {
+            throw std::runtime_error("array_pop expects 1 argument");
         }
-    }
 
-    auto it = state.arrays.find(arrayName);
-    if (it == state.arrays.end()) {
-        throw std::runtime_error("Array not found: " + arrayName);
-    }
+        auto& array = arrayArgument(args[0], "array_pop");
+        if (array.elements.empty()) {
+            throw std::runtime_error("array_pop: cannot pop from empty array");
+        }
 
-    if (it->second->elements.empty()) {
-        throw std::runtime_error("array_pop: cannot pop from empty array");
+        auto value = std::move(array.elements.back());
+        array.elements.pop_back();
+        return value;
     }
 
-    auto value = it->second->elements.back();
-    it->second->elements.pop_back();
-    return value;
-}
-
     maxlang::Value array_shift(maxlang::Context& state, const std::vector<maxlang::Value>& args) {
         if (args.size() != 1) {
             throw std::runtime_error("array_shift expects 1 argument");
         }
 
-        // Получаем имя массива из переменной или напрямую
-        std::string arrayName;
-        if (std::holds_alternative<std::string>(args[0])) {
-            arrayName = std::get<std::string>(args[0]);
-        } else {
-            // Если передан не строковый литерал, пытаемся получить значение переменной
-            auto varName = toString(state, {args[0]});
-            if (std::holds_alternative<std::string>(varName)) {
-                arrayName = std::get<std::string>(varName);
-            } else {
-                throw std::runtime_error("array_shift: expected array name (string)");
-            }
-        }
-
-        auto it = state.arrays.find(arrayName);
-        if (it == state.arrays.end()) {
-            throw std::runtime_error("Array not found: " + arrayName);
-        }
-
-        if (it->second->elements.empty()) {
+        auto& array = arrayArgument(args[0], "array_shift");
+        if (array.elements.empty()) {
             throw std::runtime_error("array_shift: cannot shift from empty array");
         }
 
-        auto value = it->second->elements.front();
-        it->second->elements.erase(it->second->elements.begin());
+        auto value = std::move(array.elements.front());
+        array.elements.erase(array.elements.begin());
         return value;
     }
 
@@ -296,12 +242,7 @@ maxlang::Value array_pop(maxlang::Context& state, const std::vector<maxlang::Val
             args[0]);
     }
 
-    maxlang::Value Factorial(maxlang::Context& state, const std::vector<maxlang::Value>& args) {
-        if (args.size() != 1) {
-            throw std::runtime_error("Factorial expects 1 argument");
-        }
-
-        int n = getIntFromValue(args[0], "Factorial");
+    int Factorial(int n) {
         if (n < 0) {
             throw std::runtime_error("Factorial: argument must be non-negative");
         }
@@ -390,12 +331,8 @@ maxlang::Value array_pop(maxlang::Context& state, const std::vector<maxlang::Val
         return a * a;
     }
 
-    maxlang::Value isSimple(maxlang::Context& state, const std::vector<maxlang::Value>& args) {
-        if (args.size() != 1) {
-            throw std::runtime_error("isSimple expects 1 argument");
-        }
-
-        long a = getIntFromValue(args[0], "isSimple");
+    int isSimple(int value) {
+        long a = value;
         for (int i = 2; i < a; i++) {
             if ((a % i) == 0) {
                 return 0; // false
@@ -526,12 +463,8 @@ maxlang::Value array_pop(maxlang::Context& state, const std::vector<maxlang::Val
         return result;
     }
 
-    maxlang::Value Fibonachi(maxlang::Context& state, const std::vector<maxlang::Value>& args) {
-        if (args.size() != 1) {
-            throw std::runtime_error("Fibonachi expects 1 argument");
-        }
-
-        short num = getIntFromValue(args[0], "Fibonachi");
+    int Fibonachi(int value) {
+        short num = value;
         if (num == 1 || num == 2) {
             return 1;
         }
@@ -579,43 +512,55 @@ maxlang::Value array_pop(maxlang::Context& state, const std::vector<maxlang::Val
     maxlang::Value endl = '\n';
 }
 
+const maxlang::Library& maxlang::stdlib::library() {
+#define FUNCTION(name) { #name, Function { name } }
+#define PURE_FUNCTION(name) { #name, Function { name, true } }
+#define PURE_TYPED_FUNCTION(name) { #name, native::wrap(name, true) }
+#define VARIABLE(name) { #name, Value { name } }
+
+    // Строится один раз на процесс и больше не меняется
+    static const Library library({
+        FUNCTION(println),
+        FUNCTION(print),
+        FUNCTION(Sleep),
+        FUNCTION(Clear),
+        FUNCTION(flush),
+        FUNCTION(input),
+        FUNCTION(getch),
+        PURE_FUNCTION(toInt),
+        PURE_FUNCTION(toDouble),
+        PURE_FUNCTION(toString),
+
+        FUNCTION(array_length),
+        FUNCTION(array_push),
+        FUNCTION(array_pop),
+        FUNCTION(array_shift),
+
+        PURE_FUNCTION(Abc),
+        PURE_TYPED_FUNCTION(Factorial),
+        // Pow и Sigmoid не сворачиваются: для дробной степени поиск логарифма может не сойтись
+        FUNCTION(Pow),
+        PURE_FUNCTION(Sqr),
+        PURE_TYPED_FUNCTION(isSimple),
+        FUNCTION(Root),
+        FUNCTION(Sqrt),
+        FUNCTION(Log),
+        FUNCTION(Ln),
+        PURE_TYPED_FUNCTION(Fibonachi),
+        PURE_FUNCTION(Round),
+        FUNCTION(Sigmoid),
+        FUNCTION(Random),
+    }, {
+        VARIABLE(endl),
+        VARIABLE(e),
+        VARIABLE(pi),
+        VARIABLE(true),
+        VARIABLE(false),
+    });
+    return library;
+}
+
 void maxlang::stdlib::init(maxlang::State& state) {
-#define FUNCTION(name) state.context().functions[#name] = { name }
-#define VARIABLE(name) state.context().variables[#name] = { name }
-
-    FUNCTION(println);
-    FUNCTION(print);
-    FUNCTION(Sleep);
-    FUNCTION(Clear);
-    FUNCTION(flush);
-    FUNCTION(input);
-    FUNCTION(getch);
-    FUNCTION(toInt);
-    FUNCTION(toDouble);
-    FUNCTION(toString);
-
-    FUNCTION(array_length);
-    FUNCTION(array_push);
-    FUNCTION(array_pop);
-    FUNCTION(array_shift);
-
-    FUNCTION(Abc);
-    FUNCTION(Factorial);
-    FUNCTION(Pow);
-    FUNCTION(Sqr);
-    FUNCTION(isSimple);
-    FUNCTION(Root);
-    FUNCTION(Sqrt);
-    FUNCTION(Log);
-    FUNCTION(Ln);
-    FUNCTION(Fibonachi);
-    FUNCTION(Round);
-    FUNCTION(Sigmoid);
-    FUNCTION(Random);
-
-    VARIABLE(endl);
-    VARIABLE(e);
-    VARIABLE(pi);
-    VARIABLE(true);
-    VARIABLE(false);
-}
\ No newline at end of file
+    state.context().functions.setLibrary(&library());
+    state.context().variables.setLibrary(&library());
+}
@@ -1,6 +1,15 @@
 #pragma once
 
+#include "library.h"
 #include "state.h"
 namespace maxlang::stdlib {
+/**
+ * @brief Builtin functions and constants, shared by all States.
+ */
+const Library& library();
+
+/**
+ * @brief Attaches library() to the state; does not copy or allocate anything.
+ */
 void init(State& state);
 }
\ No newline at end of file
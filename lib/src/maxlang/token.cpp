@@ -0,0 +1,14 @@
+#include "token.h"
+#include "scanner.h"
+
+maxlang::token::Position maxlang::token::Stream::position(size_t index) const {
+    auto offset = index < size() ? mOffsets[index] : mCode.size();
+    size_t lineStart = 0;
+    if (auto newline = mCode.substr(0, offset).rfind('\n'); newline != std::string_view::npos) {
+        lineStart = newline + 1;
+    }
+    return {
+        .line = 1 + lexer::scan::countLines(mCode.data(), mCode.data() + offset),
+        .column = static_cast<int>(offset - lineStart) + 1,
+    };
+}
@@ -1,7 +1,13 @@
 #pragma once
 
-#include <string>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <variant>
+#include <vector>
 
 namespace maxlang::token {
     enum class Keyword {
@@ -90,13 +96,26 @@ namespace maxlang::token {
     struct MinusMinus {
         auto operator<=>(const MinusMinus&) const = default;
     };   // --
+    struct PlusEqual {
+        auto operator<=>(const PlusEqual&) const = default;
+    };   // +=
+    struct MinusEqual {
+        auto operator<=>(const MinusEqual&) const = default;
+    };   // -=
+    struct AsteriskEqual {
+        auto operator<=>(const AsteriskEqual&) const = default;
+    };   // *=
+    struct SlashEqual {
+        auto operator<=>(const SlashEqual&) const = default;
+    };   // /=
+    // Identifier и String ссылаются на исходный текст, который должен жить дольше токенов
     struct Identifier {
         auto operator<=>(const Identifier&) const = default;
-        std::string value;
+        std::string_view value;
     };
     struct String {
         auto operator<=>(const String&) const = default;
-        std::string value;
+        std::string_view value;
     };
     struct Integer {
         auto operator<=>(const Integer&) const = default;
@@ -106,5 +125,167 @@ namespace maxlang::token {
 using Any = std::variant<
     Keyword, LPar, RPar, Equal, Equal2, LCurlyBracket, RCurlyBracket, Semicolon, Comma, Plus, Minus, Asterisk, Slash, Identifier,
     Integer, String,LSquareBracket,RSquareBracket,LAngleBracket,RAngleBracket,LAngleBracketEqual,RAngleBracketEqual,PlusPlus,MinusMinus,
-    NoEqual,Char,Dot,Float>;
-}
\ No newline at end of file
+    NoEqual,Char,Dot,Float,PlusEqual,MinusEqual,AsteriskEqual,SlashEqual>;
+
+    /**
+     * @brief Position of T in Any, used as the token kind in a Stream.
+     */
+    template <typename T, size_t I = 0>
+    constexpr uint8_t kindOf() {
+        if constexpr (std::is_same_v<T, std::variant_alternative_t<I, Any>>) {
+            return I;
+        } else {
+            return kindOf<T, I + 1>();
+        }
+    }
+
+    struct Position {
+        int line;
+        int column;
+    };
+
+    class Stream;
+
+    /**
+     * @brief Handle of one token in a Stream. The position past the last token reads as a ';'.
+     */
+    class Token {
+    public:
+        Token(const Stream& stream, size_t index) : mStream(&stream), mIndex(index) {}
+
+        uint8_t kind() const;
+
+        template <typename T>
+        bool is() const { return kind() == kindOf<T>(); }
+
+        template <typename T>
+        T get() const;
+
+        Any value() const;
+
+        /**
+         * @brief Computed from the source on every call; meant for error messages.
+         */
+        int line() const;
+
+    private:
+        const Stream* mStream;
+        size_t mIndex;
+    };
+
+    /**
+     * @brief Tokens of one source text stored as parallel arrays of kinds, payloads and byte offsets.
+     * Identifier and String payloads keep only the length, the text itself stays in the source,
+     * which has to outlive the stream. Lines and columns are computed from the offsets on demand.
+     */
+    class Stream {
+    public:
+        explicit Stream(std::string_view code) : mCode(code) {}
+
+        template <typename T>
+        void push(T token, uint32_t offset) {
+            Payload payload {};
+            if constexpr (std::is_same_v<T, Identifier> || std::is_same_v<T, String>) {
+                payload.length = static_cast<uint32_t>(token.value.size());
+            } else if constexpr (std::is_same_v<T, Integer>) {
+                payload.integer = token.value;
+            } else if constexpr (std::is_same_v<T, Float>) {
+                payload.floating = token.value;
+            } else if constexpr (std::is_same_v<T, Char>) {
+                payload.character = token.value;
+            } else if constexpr (std::is_same_v<T, Keyword>) {
+                payload.keyword = token;
+            }
+            mKinds.push_back(kindOf<T>());
+            mPayloads.push_back(payload);
+            mOffsets.push_back(offset);
+        }
+
+        size_t size() const { return mKinds.size(); }
+        bool empty() const { return mKinds.empty(); }
+
+        uint8_t kind(size_t index) const { return mKinds[index]; }
+        uint32_t offset(size_t index) const { return mOffsets[index]; }
+
+        template <typename T>
+        T get(size_t index) const {
+            const auto& payload = mPayloads[index];
+            if constexpr (std::is_same_v<T, Identifier>) {
+                return { mCode.substr(mOffsets[index], payload.length) };
+            } else if constexpr (std::is_same_v<T, String>) {
+                // Строка начинается после открывающей кавычки
+                return { mCode.substr(mOffsets[index] + 1, payload.length) };
+            } else if constexpr (std::is_same_v<T, Integer>) {
+                return { payload.integer };
+            } else if constexpr (std::is_same_v<T, Float>) {
+                return { payload.floating };
+            } else if constexpr (std::is_same_v<T, Char>) {
+                return { payload.character };
+            } else if constexpr (std::is_same_v<T, Keyword>) {
+                return payload.keyword;
+            } else {
+                return {};
+            }
+        }
+
+        Any operator[](size_t index) const {
+            static constexpr auto kMake = []<size_t... I>(std::index_sequence<I...>) {
+                return std::array { +[](const Stream& stream, size_t index) -> Any {
+                    return stream.get<std::variant_alternative_t<I, Any>>(index);
+                }... };
+            }(std::make_index_sequence<std::variant_size_v<Any>>());
+            return kMake[mKinds[index]](*this, index);
+        }
+
+        /**
+         * @brief Line and column (both from 1) of the token; `index == size()` gives the end of the source.
+         */
+        Position position(size_t index) const;
+
+        void clear() {
+            mKinds.clear();
+            mPayloads.clear();
+            mOffsets.clear();
+        }
+
+        /**
+         * @brief Drops the first `count` tokens; the rest keep their offsets in the source.
+         */
+        void discard(size_t count) {
+            mKinds.erase(mKinds.begin(), mKinds.begin() + count);
+            mPayloads.erase(mPayloads.begin(), mPayloads.begin() + count);
+            mOffsets.erase(mOffsets.begin(), mOffsets.begin() + count);
+        }
+
+    private:
+        union Payload {
+            int32_t integer;
+            double floating;
+            char character;
+            Keyword keyword;
+            uint32_t length;
+        };
+
+        std::string_view mCode;
+        std::vector<uint8_t> mKinds;
+        std::vector<Payload> mPayloads;
+        std::vector<uint32_t> mOffsets;
+    };
+
+    inline uint8_t Token::kind() const {
+        return mIndex < mStream->size() ? mStream->kind(mIndex) : kindOf<Semicolon>();
+    }
+
+    template <typename T>
+    T Token::get() const {
+        return mIndex < mStream->size() ? mStream->get<T>(mIndex) : T {};
+    }
+
+    inline Any Token::value() const {
+        return mIndex < mStream->size() ? (*mStream)[mIndex] : Any(Semicolon {});
+    }
+
+    inline int Token::line() const {
+        return mStream->position(mIndex).line;
+    }
+}
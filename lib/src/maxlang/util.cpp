@@ -15,7 +15,11 @@ namespace maxlang {
                     throw std::runtime_error("Ожидалось целое число" +
                         (context.empty() ? "" : " в " + context));
                 },
-                [&](const std::string&) -> int {
+                [&](const ArrayRef&) -> int {
+                    throw std::runtime_error("Ожидалось целое число" +
+                        (context.empty() ? "" : " в " + context));
+                },
+                [&](const String&) -> int {
                     throw std::runtime_error("Ожидалось целое число" +
                         (context.empty() ? "" : " в " + context));
                 },
@@ -37,7 +41,11 @@ namespace maxlang {
                     throw std::runtime_error("Ожидалось число с плавающей точкой" +
                         (context.empty() ? "" : " в " + context));
                 },
-                [&](const std::string&) -> double {
+                [&](const ArrayRef&) -> double {
+                    throw std::runtime_error("Ожидалось число с плавающей точкой" +
+                        (context.empty() ? "" : " в " + context));
+                },
+                [&](const String&) -> double {
                     throw std::runtime_error("Ожидалось число с плавающей точкой" +
                         (context.empty() ? "" : " в " + context));
                 },
@@ -1,7 +1,53 @@
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <new>
+#include <stdexcept>
 #include "value.h"
+#include "array.h"
 #include "util.h"
 
+maxlang::String::String(std::string_view text) {
+    if (text.empty()) {
+        return;
+    }
+    if (text.size() > std::numeric_limits<uint32_t>::max()) {
+        throw std::length_error("String is too long");
+    }
+    void* memory = ::operator new(sizeof(Rep) + text.size());
+    mRep = new (memory) Rep { { 1 }, static_cast<uint32_t>(text.size()) };
+    std::memcpy(mRep->chars(), text.data(), text.size());
+}
+
+void maxlang::String::release() {
+    if (mRep && mRep->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        mRep->~Rep();
+        ::operator delete(mRep);
+    }
+    mRep = nullptr;
+}
+
+maxlang::String maxlang::operator+(const String& lhs, const String& rhs) {
+    if (lhs.empty()) {
+        return rhs;
+    }
+    if (rhs.empty()) {
+        return lhs;
+    }
+    std::string result;
+    result.reserve(lhs.size() + rhs.size());
+    result.append(lhs.view()).append(rhs.view());
+    return String(result);
+}
+
+std::ostream& maxlang::operator<<(std::ostream& os, const String& string) {
+    return os << string.view();
+}
+
+std::ostream& maxlang::operator<<(std::ostream& os, const ArrayRef& array) {
+    return os << *array;
+}
+
 namespace {
     void impl(std::ostream& os, const maxlang::Value& value) {
         std::visit(
@@ -9,8 +55,9 @@ namespace {
                 [&](std::monostate) { os << "<void>"; },
                 [&](int v) { os << v; },
                 [&](double v) { os << v; },
-                [&](const std::string& v) { os << v; },
+                [&](const maxlang::String& v) { os << v; },
                 [&](char c) { os << c; },
+                [&](const maxlang::ArrayRef& array) { os << array; },
             },
             value);
     }
@@ -32,8 +79,9 @@ bool maxlang::operator==(const Value& a, const Value& b) {
             [](std::monostate, std::monostate) -> bool { return true; },
             [](int a, int b) -> bool { return a == b; },
             [](double a, double b) -> bool { return a == b; },
-            [](const std::string& a, const std::string& b) -> bool { return a == b; },
+            [](const maxlang::String& a, const maxlang::String& b) -> bool { return a == b; },
             [](char a, char b) -> bool { return a == b; },
+            [](const maxlang::ArrayRef& a, const maxlang::ArrayRef& b) -> bool { return a == b; },
             [](auto&&, auto&&) -> bool { return false; } // разные типы
         },
         a, b);
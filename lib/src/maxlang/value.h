@@ -1,17 +1,151 @@
 #pragma once
 
-#include <variant>
+#include <atomic>
+#include <compare>
+#include <concepts>
+#include <cstdint>
+#include <iosfwd>
 #include <string>
+#include <string_view>
+#include <variant>
 // УБЕРИТЕ: #include "array.h"
 
 namespace maxlang {
     // Предварительное объявление вместо включения
     struct Array;
 
-    using Value = std::variant<std::monostate /* aka void */, int, double, std::string, char>;
+    /**
+     * @brief Immutable reference-counted string.
+     *
+     * The characters live in one heap block shared by all copies, so a String is a single
+     * pointer: copying it only bumps a counter, and Value stays 16 bytes.
+     */
+    class String {
+    public:
+        String() = default;
+        String(std::string_view text);
+        String(const std::string& text) : String(std::string_view(text)) {}
+        String(const char* text) : String(std::string_view(text)) {}
+
+        String(const String& other) noexcept : mRep(other.mRep) { retain(); }
+        String(String&& other) noexcept : mRep(other.mRep) { other.mRep = nullptr; }
+        ~String() { release(); }
+
+        String& operator=(const String& other) noexcept {
+            String(other).swap(*this);
+            return *this;
+        }
+        String& operator=(String&& other) noexcept {
+            String(std::move(other)).swap(*this);
+            return *this;
+        }
+
+        void swap(String& other) noexcept { std::swap(mRep, other.mRep); }
+
+        const char* data() const { return mRep ? mRep->chars() : ""; }
+        size_t size() const { return mRep ? mRep->size : 0; }
+        bool empty() const { return size() == 0; }
+
+        std::string_view view() const { return { data(), size() }; }
+        std::string str() const { return std::string(view()); }
+        operator std::string_view() const { return view(); }
+
+        friend bool operator==(const String& lhs, const String& rhs) {
+            return lhs.mRep == rhs.mRep || lhs.view() == rhs.view();
+        }
+        friend std::strong_ordering operator<=>(const String& lhs, const String& rhs) {
+            return lhs.view() <=> rhs.view();
+        }
+
+        template <typename T>
+            requires std::convertible_to<const T&, std::string_view> && (!std::same_as<T, String>)
+        friend bool operator==(const String& lhs, const T& rhs) {
+            return lhs.view() == std::string_view(rhs);
+        }
+
+        friend String operator+(const String& lhs, const String& rhs);
+
+        // Как и у std::string, символ можно прибавить только типом char
+        template <std::same_as<char> C>
+        friend String operator+(const String& lhs, C rhs) {
+            return lhs + String(std::string_view(&rhs, 1));
+        }
+        template <std::same_as<char> C>
+        friend String operator+(C lhs, const String& rhs) {
+            return String(std::string_view(&lhs, 1)) + rhs;
+        }
+
+    private:
+        struct Rep {
+            std::atomic<uint32_t> references;
+            uint32_t size;
+
+            char* chars() { return reinterpret_cast<char*>(this + 1); }
+        };
+
+        Rep* mRep = nullptr;
+
+        void retain() const {
+            if (mRep) {
+                mRep->references.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        void release();
+    };
+
+    String operator+(const String& lhs, const String& rhs);
+    std::ostream& operator<<(std::ostream& os, const String& string);
+
+    /**
+     * @brief Counted reference to an array. Copies refer to the same array, which is freed when
+     * the last reference goes away (cycles are collected by ArrayHeap).
+     */
+    class ArrayRef {
+    public:
+        ArrayRef() = default;
+        explicit ArrayRef(Array* array) : mArray(array) { retain(); }
+
+        ArrayRef(const ArrayRef& other) : mArray(other.mArray) { retain(); }
+        ArrayRef(ArrayRef&& other) noexcept : mArray(other.mArray) { other.mArray = nullptr; }
+        ~ArrayRef() { release(); }
+
+        ArrayRef& operator=(const ArrayRef& other) {
+            ArrayRef(other).swap(*this);
+            return *this;
+        }
+        ArrayRef& operator=(ArrayRef&& other) noexcept {
+            ArrayRef(std::move(other)).swap(*this);
+            return *this;
+        }
+
+        void swap(ArrayRef& other) noexcept { std::swap(mArray, other.mArray); }
+
+        Array* get() const { return mArray; }
+        Array& operator*() const { return *mArray; }
+        Array* operator->() const { return mArray; }
+
+        // Сравнивает ссылки, а не содержимое (см. operation::equal)
+        friend bool operator==(const ArrayRef& lhs, const ArrayRef& rhs) { return lhs.mArray == rhs.mArray; }
+
+    private:
+        Array* mArray = nullptr;
+
+        // Определены в array.h, когда Array уже полный тип
+        inline void retain() const;
+        inline void release();
+    };
+
+    std::ostream& operator<<(std::ostream& os, const ArrayRef& array);
+
+    using Value = std::variant<std::monostate /* aka void */, int, double, String, char, ArrayRef>;
+    static_assert(sizeof(Value) == 16, "Value is expected to be two words");
+
     std::ostream& operator<<(std::ostream& os, const Value& value);
 
     // Объявления операторов сравнения
     bool operator==(const Value& a, const Value& b);
     bool operator!=(const Value& a, const Value& b);
-}
\ No newline at end of file
+}
+
+// Определения ArrayRef::retain/release
+#include "array.h"
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include "library.h"
+#include "value.h"
+
+namespace maxlang {
+    /**
+     * @brief Global variables of a context.
+     *
+     * Every name mentioned by compiled code gets a slot whose address never changes, so the VM
+     * binds a chunk to its slots once and then reads and writes them without name lookups.
+     * Name-based access is meant for the host.
+     *
+     * A name the table does not have yet is looked up in its Library, if one is set: the library
+     * value becomes the initial value of the slot, and from then on the variable belongs to the
+     * context like any other.
+     */
+    class Variables {
+    public:
+        struct Slot {
+            Value value;
+            bool defined = false;
+        };
+
+        /**
+         * @brief Returns the variable, defining it as void if it does not exist yet.
+         */
+        Value& operator[](const std::string& name) {
+            auto& s = slot(name);
+            s.defined = true;
+            return s.value;
+        }
+
+        /**
+         * @brief Returns the variable or nullptr if it is not defined.
+         */
+        Value* find(const std::string& name) {
+            auto it = mSlots.find(name);
+            if (it == mSlots.end()) {
+                if (!mLibrary || !mLibrary->variable(name)) {
+                    return nullptr;
+                }
+                return &slot(name).value;
+            }
+            return it->second.defined ? &it->second.value : nullptr;
+        }
+
+        const Value* find(const std::string& name) const {
+            auto it = mSlots.find(name);
+            if (it == mSlots.end()) {
+                return mLibrary ? mLibrary->variable(name) : nullptr;
+            }
+            return it->second.defined ? &it->second.value : nullptr;
+        }
+
+        bool contains(const std::string& name) const { return find(name) != nullptr; }
+
+        /**
+         * @brief Undefines the variable; a library variable of the same name stays hidden.
+         */
+        void erase(const std::string& name) {
+            if (auto it = mSlots.find(name); it != mSlots.end()) {
+                it->second = Slot {};
+            } else if (mLibrary && mLibrary->variable(name)) {
+                mSlots.emplace(name, Slot {});
+            }
+        }
+
+        /**
+         * @brief Returns the slot of the variable, creating it if needed: with the library value,
+         * or undefined.
+         */
+        Slot& slot(const std::string& name) {
+            auto [it, inserted] = mSlots.try_emplace(name);
+            if (inserted && mLibrary) {
+                if (const auto* value = mLibrary->variable(name)) {
+                    it->second = Slot { *value, true };
+                }
+            }
+            return it->second;
+        }
+
+        /**
+         * @brief Calls `f(name, value)` for every defined variable, except library variables the
+         * program has not used yet.
+         */
+        template <typename F>
+        void forEach(F&& f) const {
+            for (const auto& [name, slot] : mSlots) {
+                if (slot.defined) {
+                    f(name, slot.value);
+                }
+            }
+        }
+
+        /**
+         * @brief Sets the fallback table; the library must outlive the table. nullptr detaches it.
+         */
+        void setLibrary(const Library* library) { mLibrary = library; }
+
+        const Library* library() const { return mLibrary; }
+
+    private:
+        // std::map never moves its nodes, which keeps slot addresses stable
+        std::map<std::string, Slot> mSlots;
+        const Library* mLibrary = nullptr;
+    };
+}
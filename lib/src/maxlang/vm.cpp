@@ -0,0 +1,495 @@
+#include "vm.h"
+#include "array.h"
+#include "fmt/format.h"
+#include "operation.h"
+#include "util.h"
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+using namespace maxlang;
+using bytecode::OpCode;
+
+namespace {
+    Array& asArray(const Value& value) {
+        if (!std::holds_alternative<ArrayRef>(value)) {
+            throw std::runtime_error("Expected array for indexing");
+        }
+        return *std::get<ArrayRef>(value);
+    }
+
+    Value& element(Array& array, const Value& index) {
+        if (!std::holds_alternative<int>(index)) {
+            throw std::runtime_error("Expected integer index");
+        }
+        int idx = std::get<int>(index);
+        if (idx < 0 || idx >= static_cast<int>(array.elements.size())) {
+            throw std::runtime_error(fmt::format("Array index {} out of bounds [0, {})", idx, array.elements.size()));
+        }
+        return array.elements[idx];
+    }
+
+    int step(const Value& value, int delta) {
+        if (!std::holds_alternative<int>(value)) {
+            throw std::runtime_error(delta > 0
+                ? "Postfix increment can only be applied to integers"
+                : "Postfix decrement can only be applied to integers");
+        }
+        return std::get<int>(value) + delta;
+    }
+
+    constexpr size_t kMaxCallDepth = 200000;
+
+    // После стольких возвратов к обобщённой форме операция больше не специализируется
+    constexpr uint8_t kMaxDeoptimizations = 4;
+
+    // Один chunk может выполняться в нескольких потоках. Потоки могут переписывать форму одной
+    // инструкции друг за другом, но любая форма вычисляет то же самое, а атомарный доступ
+    // гарантирует, что прочитана будет целая операция
+    OpCode load(const bytecode::Instruction& i) {
+        return std::atomic_ref(i.op).load(std::memory_order_relaxed);
+    }
+
+    void store(const bytecode::Instruction& i, OpCode op) {
+        std::atomic_ref(i.op).store(op, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Rewrites a generic binary op into its int or double form when both operands have
+     * that type (quickening).
+     */
+    void quicken(const bytecode::Instruction& i, const Value& lhs, const Value& rhs) {
+        if (std::atomic_ref(i.deoptimizations).load(std::memory_order_relaxed) >= kMaxDeoptimizations || lhs.index() != rhs.index()) {
+            return;
+        }
+        if (std::holds_alternative<int>(lhs)) {
+            store(i, bytecode::intForm(load(i)));
+        } else if (std::holds_alternative<double>(lhs)) {
+            store(i, bytecode::doubleForm(load(i)));
+        }
+    }
+
+    void deoptimize(const bytecode::Instruction& i) {
+        store(i, bytecode::genericForm(load(i)));
+        std::atomic_ref(i.deoptimizations).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Specialized op: computes R[a] = R[b] op R[c] if both operands hold T.
+     */
+    template <typename T, typename Op>
+    bool binaryFast(Value* r, const bytecode::Instruction& i) {
+        const auto* lhs = std::get_if<T>(&r[i.b]);
+        const auto* rhs = std::get_if<T>(&r[i.c]);
+        if (!lhs || !rhs) {
+            return false;
+        }
+        if constexpr (std::is_same_v<decltype(Op {}(*lhs, *rhs)), bool>) {
+            r[i.a] = Op {}(*lhs, *rhs) ? 1 : 0;
+        } else {
+            r[i.a] = Op {}(*lhs, *rhs);
+        }
+        return true;
+    }
+
+    struct Frame {
+        // Держит прототип и его кэши живыми, даже если функцию переопределят во время вызова
+        std::shared_ptr<bytecode::Binding> binding;
+        const bytecode::Chunk* chunk;
+        bytecode::CallCache* caches;
+        const bytecode::Instruction* pc;
+        size_t base;
+        Variables::Slot* const* globals;
+        // Ключ, под которым результат вызова попадёт в Context::memo
+        const bytecode::Prototype* memoFunction = nullptr;
+        std::vector<Value> memoArgs;
+    };
+
+    /**
+     * @brief Binding of a user function to the context that holds it, created on the first call.
+     */
+    const std::shared_ptr<bytecode::Binding>& bind(const Function& function) {
+        auto& binding = function.linkage.binding;
+        if (!binding) {
+            binding = std::make_shared<bytecode::Binding>(bytecode::Binding {
+                function.prototype, std::vector<bytecode::CallCache>(function.prototype->chunk.names.size()) });
+        }
+        return binding;
+    }
+
+    /**
+     * @brief Purity analysis for memoization (see Memo). Analyzes every user function reachable
+     * from `root` together and caches the results in their Linkage until the functions change.
+     */
+    bool isPure(const Function& root, const Functions& functions) {
+        if (root.linkage.purityVersion == functions.version()) {
+            return root.linkage.pure;
+        }
+
+        std::vector<const Function*> reachable { &root };
+        for (size_t k = 0; k < reachable.size(); ++k) {
+            auto& linkage = reachable[k]->linkage;
+            const auto& prototype = *reachable[k]->prototype;
+            linkage.pure = prototype.selfContained;
+            for (const auto& name : prototype.calls) {
+                const auto* function = functions.find(name);
+                if (!function || (!function->prototype && !function->pure)) {
+                    linkage.pure = false;
+                } else if (function->prototype && std::ranges::find(reachable, function) == reachable.end()) {
+                    reachable.push_back(function);
+                }
+            }
+        }
+
+        // Нечистота передаётся вызывающим функциям, пока что-то меняется
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (const auto* caller : reachable) {
+                if (!caller->linkage.pure) {
+                    continue;
+                }
+                for (const auto& name : caller->prototype->calls) {
+                    const auto* function = functions.find(name);
+                    if (function->prototype && !function->linkage.pure) {
+                        caller->linkage.pure = false;
+                        changed = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        for (const auto* function : reachable) {
+            function->linkage.purityVersion = functions.version();
+        }
+        return root.linkage.pure;
+    }
+
+    bool memoizable(const Value* args, size_t count) {
+        return std::none_of(args, args + count, [](const Value& v) { return std::holds_alternative<ArrayRef>(v); });
+    }
+
+    void checkArguments(const bytecode::Prototype& prototype, size_t count) {
+        if (count != prototype.parameters.size()) {
+            throw std::runtime_error(fmt::format(
+                "Function expects {} arguments, got {}", prototype.parameters.size(), count));
+        }
+    }
+
+    /**
+     * @brief Runs `entry` with its registers at the bottom of `stack` (arguments already in place)
+     * and `entryCaches` as the call caches of its names.
+     */
+    Value execute(const bytecode::Chunk& entry, bytecode::CallCache* entryCaches, Context& context, std::vector<Value> stack) {
+        // Глобальные переменные связываются со слотами один раз за запуск
+        std::vector<Variables::Slot*> entryGlobals;
+        entryGlobals.reserve(entry.globals.size());
+        for (const auto& name : entry.globals) {
+            entryGlobals.push_back(&context.variables.slot(name));
+        }
+
+        std::vector<Frame> frames;
+        // Держит прототип, в который перешёл хвостовой вызов на нижнем уровне (см. vm::call)
+        std::shared_ptr<bytecode::Binding> entryBinding;
+        // Аргументы встроенных функций, память переиспользуется между вызовами
+        std::vector<Value> nativeArgs;
+        const bytecode::Chunk* chunk = &entry;
+        bytecode::CallCache* caches = entryCaches;
+        Variables::Slot* const* globals = entryGlobals.data();
+        size_t base = 0;
+        Value* r = stack.data();
+        const auto* code = chunk->code.data();
+        const auto* pc = code;
+
+        for (;;) {
+            const auto& i = *pc++;
+            switch (load(i)) {
+                case OpCode::LoadConstant:
+                    r[i.a] = chunk->constants[i.b];
+                    break;
+                case OpCode::Move:
+                    r[i.a] = r[i.b];
+                    break;
+                case OpCode::LoadGlobal: {
+                    const auto& slot = *globals[i.b];
+                    if (!slot.defined) {
+                        throw std::runtime_error("Variable not found: " + chunk->globals[i.b]);
+                    }
+                    r[i.a] = slot.value;
+                    break;
+                }
+                case OpCode::StoreGlobal: {
+                    auto& slot = *globals[i.b];
+                    slot.value = r[i.a];
+                    slot.defined = true;
+                    break;
+                }
+                case OpCode::Undefined:
+                    throw std::runtime_error("Variable not found: " + chunk->names[i.b]);
+                case OpCode::CheckDefined:
+                    if (std::holds_alternative<std::monostate>(r[i.a])) {
+                        throw std::runtime_error("Variable not found: " + chunk->names[i.b]);
+                    }
+                    break;
+
+                case OpCode::Add:
+                    quicken(i, r[i.b], r[i.c]);
+                    r[i.a] = operation::binary<std::plus<>>(r[i.b], r[i.c]);
+                    break;
+                case OpCode::Subtract:
+                    quicken(i, r[i.b], r[i.c]);
+                    r[i.a] = operation::binary<std::minus<>>(r[i.b], r[i.c]);
+                    break;
+                case OpCode::Multiply:
+                    quicken(i, r[i.b], r[i.c]);
+                    r[i.a] = operation::binary<std::multiplies<>>(r[i.b], r[i.c]);
+                    break;
+                case OpCode::Divide:
+                    quicken(i, r[i.b], r[i.c]);
+                    r[i.a] = operation::binary<std::divides<>>(r[i.b], r[i.c]);
+                    break;
+                case OpCode::Equal:
+                    quicken(i, r[i.b], r[i.c]);
+                    r[i.a] = operation::equal(r[i.b], r[i.c]) ? 1 : 0;
+                    break;
+                case OpCode::NotEqual:
+                    quicken(i, r[i.b], r[i.c]);
+                    r[i.a] = operation::equal(r[i.b], r[i.c]) ? 0 : 1;
+                    break;
+                case OpCode::Less:
+                    quicken(i, r[i.b], r[i.c]);
+                    r[i.a] = operation::binary<std::less<>>(r[i.b], r[i.c]);
+                    break;
+                case OpCode::Greater:
+                    quicken(i, r[i.b], r[i.c]);
+                    r[i.a] = operation::binary<std::greater<>>(r[i.b], r[i.c]);
+                    break;
+                case OpCode::LessEqual:
+                    quicken(i, r[i.b], r[i.c]);
+                    r[i.a] = operation::binary<std::less_equal<>>(r[i.b], r[i.c]);
+                    break;
+                case OpCode::GreaterEqual:
+                    quicken(i, r[i.b], r[i.c]);
+                    r[i.a] = operation::binary<std::greater_equal<>>(r[i.b], r[i.c]);
+                    break;
+
+// Быстрый путь: проверка типов операндов, иначе возврат к обобщённой операции и её повтор
+#define SPECIALIZED(OP, TYPE, FUNCTOR)                                  \
+                case OpCode::OP:                                        \
+                    if (!binaryFast<TYPE, FUNCTOR>(r, i)) {             \
+                        deoptimize(i);                                  \
+                        --pc;                                           \
+                    }                                                   \
+                    break;
+
+                SPECIALIZED(AddInt, int, std::plus<>)
+                SPECIALIZED(SubtractInt, int, std::minus<>)
+                SPECIALIZED(MultiplyInt, int, std::multiplies<>)
+                SPECIALIZED(EqualInt, int, std::equal_to<>)
+                SPECIALIZED(NotEqualInt, int, std::not_equal_to<>)
+                SPECIALIZED(LessInt, int, std::less<>)
+                SPECIALIZED(GreaterInt, int, std::greater<>)
+                SPECIALIZED(LessEqualInt, int, std::less_equal<>)
+                SPECIALIZED(GreaterEqualInt, int, std::greater_equal<>)
+                SPECIALIZED(AddDouble, double, std::plus<>)
+                SPECIALIZED(SubtractDouble, double, std::minus<>)
+                SPECIALIZED(MultiplyDouble, double, std::multiplies<>)
+                SPECIALIZED(DivideDouble, double, std::divides<>)
+                SPECIALIZED(LessDouble, double, std::less<>)
+                SPECIALIZED(GreaterDouble, double, std::greater<>)
+                SPECIALIZED(LessEqualDouble, double, std::less_equal<>)
+                SPECIALIZED(GreaterEqualDouble, double, std::greater_equal<>)
+#undef SPECIALIZED
+
+                case OpCode::Increment:
+                    r[i.a] = step(r[i.b], 1);
+                    break;
+                case OpCode::Decrement:
+                    r[i.a] = step(r[i.b], -1);
+                    break;
+
+                case OpCode::NewArray: {
+                    r[i.a] = context.heap().make(std::vector<Value>(r + i.b, r + i.b + i.c));
+                    break;
+                }
+                case OpCode::GetIndex: {
+                    auto value = element(asArray(r[i.b]), r[i.c]);
+                    r[i.a] = std::move(value);
+                    break;
+                }
+                case OpCode::SetIndex:
+                    element(asArray(r[i.a]), r[i.b]) = r[i.c];
+                    break;
+                case OpCode::IterNext: {
+                    if (!std::holds_alternative<ArrayRef>(r[i.a])) {
+                        throw std::runtime_error("Foreach expects array");
+                    }
+                    auto& array = *std::get<ArrayRef>(r[i.a]);
+                    int index = std::get<int>(r[i.b]);
+                    if (index < static_cast<int>(array.elements.size())) {
+                        r[i.c] = array.elements[index];
+                        r[i.b] = index + 1;
+                        ++pc;
+                    }
+                    break;
+                }
+
+                case OpCode::Jump:
+                    pc = code + i.target();
+                    break;
+                case OpCode::JumpIfFalse:
+                    if (getIntFromValue(r[i.a], "условии") == 0) {
+                        pc = code + i.target();
+                    }
+                    break;
+
+                case OpCode::Call:
+                case OpCode::TailCall: {
+                    auto& cache = caches[i.b];
+                    if (cache.version != context.functions.version()) {
+                        const auto* found = context.functions.find(chunk->names[i.b]);
+                        if (!found) {
+                            throw std::runtime_error(fmt::format("Function not found: {}", chunk->names[i.b]));
+                        }
+                        cache = bytecode::CallCache { context.functions.version(), found };
+                    }
+                    const auto& function = *cache.function;
+
+                    if (function.adapter) {
+                        r[i.a] = function.adapter(function.target, context, { r + i.a, i.c });
+                        break;
+                    }
+                    if (function.native) {
+                        nativeArgs.assign(r + i.a, r + i.a + i.c);
+                        auto result = function.native(context, nativeArgs);
+                        nativeArgs.clear();
+                        r[i.a] = std::move(result);
+                        break;
+                    }
+                    if (!function.prototype) {
+                        std::vector<Value> args(r + i.a, r + i.a + i.c);
+                        r[i.a] = function.nativeFunction(context, std::move(args));
+                        break;
+                    }
+
+                    const auto& callee = function.prototype->chunk;
+                    checkArguments(*function.prototype, i.c);
+
+                    bool memoize = context.memo && memoizable(r + i.a, i.c) && isPure(function, context.functions);
+                    if (memoize) {
+                        context.memo->validate(context.functions.version());
+                        if (const auto* result = context.memo->find(function.prototype.get(), { r + i.a, i.c })) {
+                            r[i.a] = *result;
+                            break;
+                        }
+                    }
+
+                    size_t frameSize = std::max<size_t>(callee.registerCount, 1);
+                    const auto& binding = bind(function);
+
+                    if (i.op == OpCode::TailCall) {
+                        // Аргументы переносятся в начало текущего кадра, стек кадров не растёт
+                        size_t used = std::max<size_t>(chunk->registerCount, 1);
+                        if (stack.size() < base + frameSize) {
+                            stack.resize(std::max(base + frameSize, stack.size() * 2));
+                            r = stack.data() + base;
+                        }
+                        std::move(r + i.a, r + i.a + i.c, r);
+                        std::fill(r + i.c, r + std::max(frameSize, used), Value {});
+
+                        // Прототип текущей функции может освободиться здесь: i и chunk больше не нужны
+                        auto& keepAlive = frames.empty() ? entryBinding : frames.back().binding;
+                        keepAlive = binding;
+                        chunk = &callee;
+                        caches = keepAlive->callCaches.data();
+                        code = chunk->code.data();
+                        pc = code;
+                        break;
+                    }
+
+                    if (frames.size() >= kMaxCallDepth) {
+                        throw std::runtime_error("Stack overflow");
+                    }
+
+                    // Кадр вызываемой функции начинается с регистров аргументов
+                    frames.push_back(Frame { binding, chunk, caches, pc, base, globals });
+                    if (memoize) {
+                        frames.back().memoFunction = function.prototype.get();
+                        frames.back().memoArgs.assign(r + i.a, r + i.a + i.c);
+                    }
+                    base += i.a;
+                    if (stack.size() < base + frameSize) {
+                        stack.resize(std::max(base + frameSize, stack.size() * 2));
+                    }
+                    r = stack.data() + base;
+                    std::fill(r + i.c, r + frameSize, Value {});
+
+                    chunk = &callee;
+                    caches = binding->callCaches.data();
+                    globals = nullptr;
+                    code = chunk->code.data();
+                    pc = code;
+                    break;
+                }
+                case OpCode::DefineFunction: {
+                    const auto& prototype = chunk->prototypes[i.a];
+                    context.functions[prototype->name] = Function(prototype);
+                    break;
+                }
+                case OpCode::Return:
+                case OpCode::ReturnVoid: {
+                    Value result = i.op == OpCode::Return ? std::move(r[i.a]) : Value {};
+                    if (frames.empty()) {
+                        return result;
+                    }
+
+                    auto& caller = frames.back();
+                    if (caller.memoFunction) {
+                        context.memo->insert(caller.memoFunction, std::move(caller.memoArgs), result);
+                    }
+                    chunk = caller.chunk;
+                    caches = caller.caches;
+                    pc = caller.pc;
+                    base = caller.base;
+                    globals = caller.globals;
+                    frames.pop_back();
+
+                    code = chunk->code.data();
+                    r = stack.data() + base;
+                    // Результат попадает в регистр, с которого начинались аргументы
+                    r[(pc - 1)->a] = std::move(result);
+                    break;
+                }
+            }
+        }
+    }
+}   // namespace
+
+Value maxlang::vm::run(const bytecode::Chunk& chunk, Context& context) {
+    // Кэши верхнего уровня живут один запуск: сам chunk может одновременно выполняться в других контекстах
+    std::vector<bytecode::CallCache> caches(chunk.names.size());
+    return execute(chunk, caches.data(), context, std::vector<Value>(chunk.registerCount));
+}
+
+Value maxlang::vm::call(const Function& function, Context& context, std::vector<Value> args) {
+    if (function.adapter) {
+        return function.adapter(function.target, context, args);
+    }
+    if (function.native) {
+        return function.native(context, args);
+    }
+    if (!function.prototype) {
+        return function.nativeFunction(context, std::move(args));
+    }
+
+    const auto& chunk = function.prototype->chunk;
+    checkArguments(*function.prototype, args.size());
+    args.resize(std::max<size_t>(chunk.registerCount, 1));
+    // Копия держит кэши, даже если функцию переопределят во время вызова
+    auto binding = bind(function);
+    return execute(chunk, binding->callCaches.data(), context, std::move(args));
+}
+
+Value maxlang::Function::operator()(Context& context, std::vector<Value> args) const {
+    return vm::call(*this, context, std::move(args));
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "bytecode.h"
+#include "context.h"
+
+/**
+ * @details
+ * Register VM that executes chunks produced by the compiler (see compiler.h).
+ *
+ * All frames of one run share a single register stack. A call to a user function pushes
+ * a frame whose registers start at the caller's argument registers, so arguments are
+ * passed without copying and calls do not recurse on the native stack.
+ */
+namespace maxlang::vm {
+    /**
+     * @brief Executes a chunk against the context and returns the value the chunk returned.
+     */
+    Value run(const bytecode::Chunk& chunk, Context& context);
+
+    /**
+     * @brief Calls a native or user function from host code.
+     */
+    Value call(const Function& function, Context& context, std::vector<Value> args);
+}
@@ -1,4 +1,5 @@
 #include "maxlang/lexer.h"
+#include "maxlang/scanner.h"
 #include "maxlang/token.h"
 #include <gtest/gtest.h>
 
@@ -27,7 +28,7 @@ fn main() {
     // Сравниваем только токены (первые элементы пар), игнорируя номера строк
     ASSERT_EQ(processed.size(), expected.size());
     for (size_t i = 0; i < processed.size(); ++i) {
-        EXPECT_EQ(processed[i].first, expected[i]);
+        EXPECT_EQ(processed[i], expected[i]);
     }
 }
 
@@ -42,6 +43,71 @@ TEST(Lexer, Case2) {
     // Сравниваем только токены (первые элементы пар), игнорируя номера строк
     ASSERT_EQ(processed.size(), expected.size());
     for (size_t i = 0; i < processed.size(); ++i) {
-        EXPECT_EQ(processed[i].first, expected[i]);
+        EXPECT_EQ(processed[i], expected[i]);
     }
+}
+TEST(Lexer, SourceViews) {
+    std::string_view code = "name = \"text\" + 2.5 + 7;";
+    auto processed = maxlang::lexer::process(code);
+    ASSERT_EQ(processed.size(), 8);
+
+    // Имена и строки указывают прямо в исходный текст
+    auto identifier = std::get<Identifier>(processed[0]).value;
+    EXPECT_EQ(identifier.data(), code.data());
+    EXPECT_EQ(std::get<String>(processed[2]).value.data(), code.data() + 8);
+    EXPECT_EQ(processed[4], Any(Float { .value = 2.5 }));
+    EXPECT_EQ(processed[6], Any(Integer { .value = 7 }));
+
+    EXPECT_THROW(maxlang::lexer::process("x = 99999999999;"), std::runtime_error);
+}
+
+
+TEST(Lexer, ScannersAgree) {
+    // Длинные имена, строки, комментарии и пробелы проходят через все ширины сканера, включая хвосты
+    std::string code;
+    for (int i = 0; i < 50; ++i) {
+        code += std::string(i, ' ') + "identifier_" + std::string(i, 'x') + std::to_string(i) + " = \"s" + std::string(i, 'y') + "\";";
+        code += std::string(i % 40, '\n') + "\t\r\n/* comment\n\n" + std::string(i + 1, '*') + "/ // tail" + std::string(i, '/') + "\n";
+    }
+    code += "last";
+
+    auto previous = maxlang::lexer::scan::active();
+    maxlang::lexer::scan::use(maxlang::lexer::scan::Isa::Scalar);
+    auto expected = maxlang::lexer::process(code);
+    ASSERT_EQ(expected.size(), 201);
+    const auto lines = 1 + 50 * 4 + (39 * 40 / 2) + (9 * 10 / 2);
+
+    for (int isa = 0; isa <= static_cast<int>(maxlang::lexer::scan::best()); ++isa) {
+        maxlang::lexer::scan::use(static_cast<maxlang::lexer::scan::Isa>(isa));
+        auto processed = maxlang::lexer::process(code);
+        ASSERT_EQ(processed.size(), expected.size());
+        for (size_t i = 0; i < processed.size(); ++i) {
+            EXPECT_EQ(processed[i], expected[i]);
+            EXPECT_EQ(processed.offset(i), expected.offset(i));
+        }
+        EXPECT_EQ(processed.position(200).line, lines) << maxlang::lexer::scan::name(maxlang::lexer::scan::active());
+    }
+    maxlang::lexer::scan::use(previous);
+}
+
+TEST(Lexer, LazyPositions) {
+    std::string_view code = "a = 1; // comment\n/* two\nlines */\n  b = 'c';";
+    auto processed = maxlang::lexer::process(code);
+    ASSERT_EQ(processed.size(), 8);
+    EXPECT_EQ(processed.kind(4), kindOf<Identifier>());
+    EXPECT_EQ(processed.position(0).line, 1);
+    EXPECT_EQ(processed.position(4).line, 4);
+    EXPECT_EQ(processed.position(4).column, 3);
+    EXPECT_EQ(processed.position(6).column, 7);
+    EXPECT_EQ(processed.position(processed.size()).line, 4);
+
+    // Номер строки в ошибке считается по смещению токена
+    EXPECT_THROW({
+        try {
+            maxlang::lexer::process("x = 1;\n\n  y = 2 $;");
+        } catch (const std::runtime_error& e) {
+            EXPECT_STREQ(e.what(), "Unexpected character: '$', at line 3");
+            throw;
+        }
+    }, std::runtime_error);
 }
\ No newline at end of file
@@ -1,5 +1,17 @@
 #include "maxlang/state.h"
+#include "maxlang/cache.h"
+#include "maxlang/compiler.h"
+#include "maxlang/optimizer.h"
+#include "maxlang/parser.h"
+#include "maxlang/lexer.h"
+#include "maxlang/stdlib.h"
+#include "maxlang/vm.h"
 #include <gtest/gtest.h>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
 
 TEST(Eblang, Math1) {
     maxlang::State g;
@@ -88,7 +100,7 @@ TEST(Eblang, FunctionCall4) {
             }
             called = true;
             EXPECT_EQ(std::get<int>(args[0]), 228);
-            EXPECT_EQ(std::get<std::string>(args[1]), "322");
+            EXPECT_EQ(std::get<maxlang::String>(args[1]), "322");
             return std::monostate {};
         }
     );
@@ -111,7 +123,7 @@ TEST(Eblang, FunctionCall5) {
                 case 1: // second call
                     EXPECT_EQ(args.size(), 2);
                     EXPECT_EQ(std::get<int>(args[0]), 228);
-                    EXPECT_EQ(std::get<std::string>(args[1]), "322");
+                    EXPECT_EQ(std::get<maxlang::String>(args[1]), "322");
                     break;
             }
             return std::monostate {};
@@ -193,10 +205,631 @@ TEST(Eblang, StringEqual) {
 
 TEST(Eblang, StringConcat) {
     maxlang::State g;
-    EXPECT_EQ(std::get<std::string>(g.evaluate("\"a\" + \"b\"")), "ab");
+    EXPECT_EQ(std::get<maxlang::String>(g.evaluate("\"a\" + \"b\"")), "ab");
 }
 
 TEST(Eblang, While) {
     maxlang::State g;
-    EXPECT_EQ(std::get<std::string>(g.evaluate("a = '';while (a != 'aaaaaaaaaa'){a = a + 'a'}")), "aaaaaaaaaa");
-}
\ No newline at end of file
+    EXPECT_EQ(std::get<maxlang::String>(g.evaluate("a = '';while (a != 'aaaaaaaaaa'){a = a + 'a'}")), "aaaaaaaaaa");
+}
+TEST(Eblang, ForLoop) {
+    maxlang::State g;
+    g.run(R"(
+sum = 0;
+for (i = 0; i < 10; i++) {
+    if (i == 3) {
+        continue;
+    }
+    if (i == 6) {
+        break;
+    }
+    sum = sum + i;
+}
+)");
+    EXPECT_EQ(std::get<int>(g.context().variables["sum"]), 0 + 1 + 2 + 4 + 5);
+}
+
+TEST(Eblang, ForEach) {
+    maxlang::State g;
+    g.run(R"(
+sum = 0;
+foreach (x in [1, 2, 3, 4]) {
+    sum = sum + x;
+}
+)");
+    EXPECT_EQ(std::get<int>(g.context().variables["sum"]), 10);
+}
+
+TEST(Eblang, Arrays) {
+    maxlang::State g;
+    g.run(R"(
+board = [[1, 2], [3, 4]];
+board[1][0] = 7;
+row = board[0];
+row[1]++;
+x = (board[1][0]) + (board[0][1]);
+)");
+    EXPECT_EQ(std::get<int>(g.context().variables["x"]), 10);
+    EXPECT_EQ(std::get<int>(g.evaluate("[1, 2] == [1, 2]")), 1);
+    EXPECT_EQ(std::get<int>(g.evaluate("[1, 2] != [1, 3]")), 1);
+}
+
+TEST(Eblang, ArrayHandles) {
+    maxlang::State g;
+    maxlang::stdlib::init(g);
+    g.run(R"(
+a = [1, 2];
+b = a;
+array_push(b, 3);
+name = "a";
+)");
+    auto a = std::get<maxlang::ArrayRef>(g.context().variables["a"]);
+    EXPECT_EQ(a, std::get<maxlang::ArrayRef>(g.context().variables["b"]));
+    EXPECT_EQ(a->size(), 3);
+    EXPECT_EQ(std::get<int>(g.evaluate("array_length(a)")), 3);
+    EXPECT_EQ(std::get<maxlang::String>(g.evaluate("toString(a)")), "[1, 2, 3]");
+    EXPECT_EQ(std::get<int>(g.evaluate("name == \"a\"")), 1);
+    EXPECT_THROW(g.evaluate("name[0]"), std::runtime_error);
+    EXPECT_THROW(g.evaluate("array_length(name)"), std::runtime_error);
+}
+
+TEST(Eblang, ArrayReclamation) {
+    maxlang::State g;
+    auto& heap = g.context().heap();
+    g.run(R"(
+keep = [[1, 2], [3, 4]];
+for (i = 0; i < 10000; i++) {
+    pair = [i, i + 1];
+}
+)");
+    EXPECT_EQ(heap.count(), 4);
+    EXPECT_GE(heap.bytes(), 4 * sizeof(maxlang::Array));
+
+    g.run("loop = [0]; loop[0] = loop; loop = 0; keep = 0;");
+    EXPECT_EQ(heap.count(), 2);
+    EXPECT_EQ(heap.collectCycles(), 1);
+    EXPECT_EQ(heap.count(), 1);
+
+    // Длинная цепочка освобождается без рекурсии
+    g.run("l = 0; for (i = 0; i < 1000000; i++) { l = [l, i]; } l = 0;");
+    EXPECT_EQ(heap.count(), 1);
+}
+
+TEST(Eblang, UserFunction) {
+    maxlang::State g;
+    g.run(R"(
+fn fact(n) {
+    if (n <= 1) {
+        return 1;
+    }
+    return n * fact(n - 1);
+}
+n = 3;
+x = fact(5);
+)");
+    EXPECT_EQ(std::get<int>(g.context().variables["x"]), 120);
+    EXPECT_EQ(std::get<int>(g.context().variables["n"]), 3);
+    EXPECT_THROW(g.evaluate("fact()"), std::runtime_error);
+}
+
+TEST(Eblang, FunctionScope) {
+    maxlang::State g;
+    g.run(R"(
+a = 1;
+fn f() {
+    return a;
+}
+)");
+    EXPECT_THROW(g.evaluate("f()"), std::runtime_error);
+    EXPECT_EQ(std::get<int>(g.context().variables["a"]), 1);
+}
+
+TEST(Eblang, UnassignedLocal) {
+    maxlang::State g;
+    g.run(R"(
+fn early() { y = x; x = 1; return y; }
+fn maybe(c) { if (c) { x = 1; } return x; }
+fn nothing() { return; }
+fn empty(c) { if (c) { x = nothing(); } return x; }
+fn loop(n) { for (i = 0; i < n; i++) { if (i > 0) { s = s + i; } else { s = 0; } } return s; }
+)");
+    EXPECT_THROW(g.evaluate("early()"), std::runtime_error);
+    EXPECT_EQ(g.evaluate("maybe(1)"), maxlang::Value(1));
+    EXPECT_THROW(g.evaluate("maybe(0)"), std::runtime_error);
+    // Присвоенный void отличается от отсутствующей переменной
+    EXPECT_EQ(g.evaluate("empty(1)"), maxlang::Value());
+    EXPECT_THROW(g.evaluate("empty(0)"), std::runtime_error);
+    EXPECT_EQ(g.evaluate("loop(4)"), maxlang::Value(6));
+}
+
+TEST(Eblang, LocalVariables) {
+    maxlang::State g;
+    g.run(R"(
+fn sum(n) {
+    s = 0;
+    for (i = 0; i < n; i++) {
+        s = s + i;
+    }
+    t = s;
+    s = s++;
+    return s + t;
+}
+x = sum(5);
+)");
+    EXPECT_EQ(std::get<int>(g.context().variables["x"]), 20);
+    EXPECT_FALSE(g.context().variables.contains("s"));
+    EXPECT_FALSE(g.context().variables.contains("i"));
+}
+
+TEST(Eblang, UndefinedVariable) {
+    maxlang::State g;
+    EXPECT_THROW(g.evaluate("missing + 1"), std::runtime_error);
+    g.context().variables["missing"] = 1;
+    EXPECT_EQ(std::get<int>(g.evaluate("missing + 1")), 2);
+}
+
+TEST(Eblang, DeepRecursion) {
+    maxlang::State g;
+    g.run(R"(
+fn depth(n) {
+    if (n == 0) {
+        return 0;
+    }
+    return 1 + depth(n - 1);
+}
+fn make(n) {
+    return [n, n + 1];
+}
+x = depth(50000);
+pair = make(4);
+y = (pair[1]);
+)");
+    EXPECT_EQ(std::get<int>(g.context().variables["x"]), 50000);
+    EXPECT_EQ(std::get<int>(g.context().variables["y"]), 5);
+    EXPECT_EQ(std::get<int>(maxlang::vm::call(g.context().functions["depth"], g.context(), {3})), 3);
+}
+
+TEST(Eblang, CompactValue) {
+    static_assert(sizeof(maxlang::Value) == 16);
+    maxlang::String hello = "hello";
+    maxlang::Value copy = hello;
+    EXPECT_EQ(std::get<maxlang::String>(copy).data(), hello.data());
+    EXPECT_EQ(hello + ' ' + maxlang::String("world"), "hello world");
+    EXPECT_TRUE(maxlang::String() == "");
+    EXPECT_LT(maxlang::String("a"), maxlang::String("b"));
+}
+
+TEST(Eblang, ConstantFolding) {
+    maxlang::State g;
+    maxlang::stdlib::init(g);
+    std::ostringstream log;
+    g.setFoldingLog(&log);
+    g.run("x = 2 * 60 + Sqr(16); y = -5; z = 1 / 0.5;");
+    EXPECT_EQ(std::get<double>(g.context().variables["x"]), 376.0);
+    EXPECT_EQ(std::get<int>(g.context().variables["y"]), -5);
+    EXPECT_NE(log.str().find("folded Sqr(16) -> 256\n"), std::string::npos);
+
+    // Вызов в ветке, которая не выполняется, не должен вычисляться при компиляции
+    g.run("if (0) { w = Pow(2, 0.5); } done = 1;");
+    EXPECT_EQ(std::get<int>(g.context().variables["done"]), 1);
+    EXPECT_EQ(log.str().find("folded Pow"), std::string::npos);
+
+    auto tokens = maxlang::lexer::process("a = Factorial(5); b = x + 1; c = Factorial(-1); d = \"a\" - 1;");
+    maxlang::expression::Tree tree;
+    maxlang::Parser parser(tokens, tree);
+    auto commands = parser.parseCommandSequence();
+    EXPECT_EQ(maxlang::optimizer::fold(tree, commands, g.context()), 2); // Factorial(5) и -1
+
+    // Функции программы не сворачиваются, даже если совпадают по имени со встроенными
+    g.run("fn Sqr(v) { return 0; } s = Sqr(3);");
+    EXPECT_EQ(std::get<int>(g.context().variables["s"]), 0);
+}
+
+TEST(Eblang, FlatTree) {
+    maxlang::expression::Tree tree;
+    std::string source;
+    for (int i = 0; i < 2000; ++i) {
+        source += "v" + std::to_string(i % 10) + " = [\"s\", " + std::to_string(i) + "];";
+    }
+    auto tokens = maxlang::lexer::process(source);
+    maxlang::Parser parser(tokens, tree);
+    auto commands = parser.parseCommandSequence();
+    ASSERT_EQ(commands.size, 2000);
+    EXPECT_EQ(tree.size(), 2000 * 4);
+
+    // Имена хранятся один раз и не зависят от токенов
+    tokens.clear();
+    const auto& last = tree[tree[commands].back()];
+    ASSERT_EQ(last.kind, maxlang::expression::Kind::VariableAssignment);
+    EXPECT_EQ(tree.name(last.variable.name), "v9");
+    EXPECT_EQ(last.variable.name, tree[tree[commands][9]].variable.name);
+
+    const auto& array = tree[last.variable.value];
+    ASSERT_EQ(array.kind, maxlang::expression::Kind::ArrayCreation);
+    ASSERT_EQ(array.elements.size, 2);
+    EXPECT_EQ(tree.constant(tree[tree[array.elements][1]].operand), maxlang::Value(1999));
+}
+
+TEST(Eblang, QuickenedOperations) {
+    maxlang::State g;
+    g.run(R"(
+fn add(a, b) {
+    return a + b;
+}
+fn less(a, b) {
+    return a < b;
+}
+i = add(1, 2);
+i = add(i, 2);
+d = add(1.5, 2.0);
+s = add("a", "b");
+mixed = add(1, 0.5);
+x = less(1, 2) + less(2.5, 1.0) + less("a", "b");
+)");
+    EXPECT_EQ(std::get<int>(g.context().variables["i"]), 5);
+    EXPECT_EQ(std::get<double>(g.context().variables["d"]), 3.5);
+    EXPECT_EQ(std::get<maxlang::String>(g.context().variables["s"]), "ab");
+    EXPECT_EQ(std::get<double>(g.context().variables["mixed"]), 1.5);
+    EXPECT_EQ(std::get<int>(g.context().variables["x"]), 2);
+}
+
+TEST(Eblang, CallSiteCache) {
+    maxlang::State g;
+    g.context().functions["f"] = maxlang::Function(
+        [](maxlang::Context&, std::vector<maxlang::Value>) -> maxlang::Value { return 1; });
+    g.run(R"(
+fn twice() {
+    return f() + f();
+}
+a = twice();
+)");
+    EXPECT_EQ(std::get<int>(g.context().variables["a"]), 2);
+
+    g.context().functions["f"] = maxlang::Function(
+        [](maxlang::Context&, std::vector<maxlang::Value>) -> maxlang::Value { return 10; });
+    EXPECT_EQ(std::get<int>(g.evaluate("twice()")), 20);
+
+    g.run("fn f() { return 100; } b = twice();");
+    EXPECT_EQ(std::get<int>(g.context().variables["b"]), 200);
+
+    g.context().functions.erase("f");
+    EXPECT_THROW(g.evaluate("twice()"), std::runtime_error);
+}
+
+TEST(Eblang, CompoundAssignment) {
+    maxlang::State g;
+    maxlang::stdlib::init(g);
+    g.run("x = 10; x += 5; x -= 3; x *= 4; x /= 6; s = \"a\"; s += \"b\";");
+    EXPECT_EQ(std::get<int>(g.context().variables["x"]), 8);
+    EXPECT_EQ(g.context().variables["s"], maxlang::Value("ab"));
+
+    // Индекс вычисляется один раз
+    g.run("a = [1, 2, 3]; i = 0; a[i++] += 10; y = (a[1] *= 3);");
+    EXPECT_EQ(g.evaluate("a[0] + i"), maxlang::Value(12));
+    EXPECT_EQ(std::get<int>(g.context().variables["y"]), 6);
+
+    g.run("fn count(n) { total = 0; for (k = 0; k < n; k++) { total += k; } return total; } c = count(100);");
+    EXPECT_EQ(std::get<int>(g.context().variables["c"]), 4950);
+
+    EXPECT_THROW(g.run("1 += 2;"), std::runtime_error);
+}
+
+TEST(Eblang, TailCalls) {
+    maxlang::State g;
+    g.run(R"(
+fn sum(n, acc) {
+    if (n == 0) {
+        return acc;
+    }
+    return sum(n - 1, acc + 1);
+}
+fn even(n) {
+    if (n == 0) {
+        return 1;
+    }
+    return odd(n - 1);
+}
+fn odd(n) {
+    if (n == 0) {
+        return 0;
+    }
+    return even(n - 1);
+}
+fn wrap(v) {
+    return toWrap(v);
+}
+s = sum(1000000, 0);
+e = even(300001);
+)");
+    EXPECT_EQ(std::get<int>(g.context().variables["s"]), 1000000);
+    EXPECT_EQ(std::get<int>(g.context().variables["e"]), 0);
+    EXPECT_EQ(std::get<int>(maxlang::vm::call(g.context().functions["sum"], g.context(), {300000, 5})), 300005);
+
+    g.context().functions["toWrap"] = maxlang::Function(
+        [](maxlang::Context&, std::vector<maxlang::Value> args) -> maxlang::Value { return std::get<int>(args[0]) + 1; });
+    EXPECT_EQ(std::get<int>(g.evaluate("wrap(1)")), 2);
+}
+
+TEST(Eblang, Memoization) {
+    maxlang::State g;
+    maxlang::stdlib::init(g);
+    g.context().memo.emplace(1000);
+    g.run(R"(
+fn fib(n) {
+    if (n < 2) {
+        return n;
+    }
+    return fib(n - 1) + fib(n - 2);
+}
+fn noisy(n) {
+    print("");
+    return n;
+}
+fn first(a) {
+    return a[0];
+}
+x = fib(45);
+y = noisy(1) + noisy(1);
+z = first([1]) + first([1]);
+)");
+    EXPECT_EQ(std::get<int>(g.context().variables["x"]), 1134903170);
+    // noisy и first не чистые и в таблицу не попадают
+    auto& memo = *g.context().memo;
+    EXPECT_EQ(memo.misses(), 46);
+    EXPECT_EQ(memo.hits(), 43);
+    EXPECT_EQ(memo.size(), 46);
+
+    // Переопределение функции сбрасывает таблицу
+    g.run("fn fib(n) { return n; } w = fib(5);");
+    EXPECT_EQ(std::get<int>(g.context().variables["w"]), 5);
+    EXPECT_EQ(memo.size(), 1);
+}
+
+TEST(Eblang, StreamingRun) {
+    maxlang::State g;
+    maxlang::stdlib::init(g);
+    g.runStreaming(R"(
+fn sum(n) { s = 0; for (i = 0; i < n; i++) { s = s + twice(i); } return s; }
+fn twice(v) { return v * 2; }
+total = sum(10);
+if (total > 0) { return; }
+total = -1;
+)");
+    EXPECT_EQ(std::get<int>(g.context().variables["total"]), 90);
+
+    // Операторы до синтаксической ошибки уже выполнены
+    EXPECT_THROW(g.runStreaming("a = 1; b = a + 1; c = (;"), std::runtime_error);
+    EXPECT_EQ(std::get<int>(g.context().variables["b"]), 2);
+    EXPECT_FALSE(g.context().variables.contains("c"));
+}
+
+TEST(Eblang, StreamingMatchesRun) {
+    // Встроенную функцию перекрывает более поздний оператор, break вне цикла завершает программу
+    for (auto code : { "fn g() { return Sqr(16); } fn Sqr(a) { return 0; } y = g();",
+                       "y = 1; break; y = 2;",
+                       "y = 1; if (y == 1) { break; } y = 2;",
+                       "for (i = 0; i < 3; i++) { break; } y = i;" }) {
+        maxlang::State whole;
+        maxlang::State streamed;
+        maxlang::stdlib::init(whole);
+        maxlang::stdlib::init(streamed);
+        whole.run(code);
+        streamed.runStreaming(code);
+        EXPECT_EQ(whole.context().variables["y"], streamed.context().variables["y"]) << code;
+    }
+}
+
+TEST(Eblang, CompiledCache) {
+    auto path = std::filesystem::temp_directory_path() / "maxlang_cache_test.mppc";
+    std::filesystem::remove(path);
+    std::string code = "fn f(n) { return n * 2.5; } x = f(4); s = \"ab\" + 'c'; for (i = 0; i < 3; i++) { x = x + 1; }";
+
+    maxlang::State first;
+    first.runCached(code, path);
+    ASSERT_TRUE(std::filesystem::exists(path));
+
+    maxlang::State second;
+    second.runCached(code, path);
+    EXPECT_EQ(second.context().variables["x"], maxlang::Value(13.0));
+    EXPECT_EQ(second.context().variables["s"], maxlang::Value("abc"));
+
+    // Кэш подходит к исходнику по хэшу, поэтому подменённая программа выполняется без разбора
+    auto tokens = maxlang::lexer::process("x = 42;");
+    maxlang::expression::Tree tree;
+    maxlang::Parser parser(tokens, tree);
+    std::vector<maxlang::bytecode::Chunk> chunks;
+    chunks.push_back(maxlang::compiler::compile(tree, parser.parseCommandSequence()));
+    std::ofstream(path, std::ios::binary) << maxlang::cache::save(chunks, maxlang::cache::hash(code));
+    second.runCached(code, path);
+    EXPECT_EQ(second.context().variables["x"], maxlang::Value(42));
+
+    // Программа, собранная без встроенных функций, не подходит контексту с ними
+    maxlang::State library;
+    maxlang::stdlib::init(library);
+    library.runCached(code, path);
+    EXPECT_EQ(library.context().variables["x"], maxlang::Value(13.0));
+    std::ofstream(path, std::ios::binary) << maxlang::cache::save(chunks, maxlang::cache::key(code, &maxlang::stdlib::library()));
+    library.runCached(code, path);
+    EXPECT_EQ(library.context().variables["x"], maxlang::Value(42));
+
+    // Временные файлы писателей не остаются рядом с кэшем
+    EXPECT_EQ(std::ranges::count_if(std::filesystem::directory_iterator(path.parent_path()), [&](const auto& entry) {
+        return entry.path().filename().string().starts_with(path.filename().string() + ".");
+    }), 0);
+
+    // Изменённый исходник и повреждённый файл компилируются заново
+    second.runCached("x = 7;", path);
+    EXPECT_EQ(second.context().variables["x"], maxlang::Value(7));
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) / 2);
+    second.runCached("x = 7;", path);
+    EXPECT_EQ(second.context().variables["x"], maxlang::Value(7));
+    EXPECT_FALSE(maxlang::cache::load("MPPC", 0).has_value());
+    std::filesystem::remove(path);
+}
+
+TEST(Eblang, CompiledProgram) {
+    maxlang::State g;
+    maxlang::stdlib::init(g);
+    auto program = g.compile("x * x + Pow(2, 3)");
+
+    // Переменные читаются при каждом запуске, а не при компиляции
+    for (int x = 0; x < 100; ++x) {
+        g.context().variables["x"] = x;
+        EXPECT_EQ(g.evaluate(program), maxlang::Value(x * x + 8.0));
+    }
+    g.context().variables["x"] = 1.5;
+    EXPECT_EQ(g.evaluate(program), maxlang::Value(10.25));
+
+    auto increment = g.compile("counter = counter + 1;");
+    g.context().variables["counter"] = 0;
+    auto copy = increment;
+    g.execute(increment);
+    g.execute(copy);
+    EXPECT_EQ(g.context().variables["counter"], maxlang::Value(2));
+
+    EXPECT_THROW(g.compile("x = (;"), std::runtime_error);
+}
+
+TEST(Eblang, SharedProgramThreads) {
+    maxlang::State compiler;
+    auto program = compiler.compile(R"(
+fn twice(v) { return v + v; }
+fn sum(n, step) { s = 0; for (i = 0; i < n; i++) { s = s + twice(i * step); } return s; }
+result = sum(2000, step);
+)");
+
+    // Каждый поток со своим контекстом выполняет один и тот же код: int и double
+    // переписывают одни и те же инструкции в разные формы
+    std::vector<maxlang::Value> results(8);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < results.size(); ++t) {
+        threads.emplace_back([&, t] {
+            maxlang::State g;
+            maxlang::stdlib::init(g);
+            for (int k = 0; k < 20; ++k) {
+                g.context().variables["step"] = t % 2 ? maxlang::Value(1) : maxlang::Value(0.5);
+                g.execute(program);
+            }
+            results[t] = g.context().variables["result"];
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (size_t t = 0; t < results.size(); ++t) {
+        EXPECT_EQ(results[t], t % 2 ? maxlang::Value(3998000) : maxlang::Value(1999000.0));
+    }
+}
+
+TEST(Eblang, SnapshotFork) {
+    maxlang::State prelude;
+    maxlang::stdlib::init(prelude);
+    prelude.run("fn scale(v) { return v * 10; } limit = 5; a = [1, 2]; b = a; nested = [a, 'x'];");
+    auto snapshot = prelude.snapshot();
+
+    maxlang::State first(snapshot);
+    first.run("a[0] = 100; array_push(b, 3); limit = scale(limit);");
+    // Массив, на который ссылаются несколько переменных, остаётся общим внутри копии
+    EXPECT_EQ(first.evaluate("b[0] + nested[0][2] + limit"), maxlang::Value(153));
+
+    maxlang::State second(snapshot);
+    EXPECT_EQ(second.evaluate("a[0] + array_length(b) + limit"), maxlang::Value(8));
+    EXPECT_EQ(prelude.evaluate("a[0] + array_length(nested[0])"), maxlang::Value(3));
+
+    auto third = first.fork();
+    third.run("fn scale(v) { return v; } nested[0][0] = 7;");
+    EXPECT_EQ(first.evaluate("scale(a[0])"), maxlang::Value(1000));
+    EXPECT_EQ(third.evaluate("scale(b[0])"), maxlang::Value(7));
+}
+
+TEST(Eblang, BuiltinLibrary) {
+    maxlang::State first;
+    maxlang::State second;
+    maxlang::stdlib::init(first);
+    maxlang::stdlib::init(second);
+    EXPECT_EQ(first.context().functions.find("Pow"), second.context().functions.find("Pow"));
+
+    // Определения программы перекрывают встроенные имена только в своём контексте
+    first.run("fn Pow(a, b) { return a + b; } pi = 3;");
+    EXPECT_EQ(first.evaluate("Pow(2, 3) + pi"), maxlang::Value(8));
+    EXPECT_EQ(second.evaluate("Pow(2, 3) + pi"), maxlang::Value(8 + 3.14159));
+
+    first.context().functions.erase("Pow");
+    EXPECT_EQ(first.evaluate("Pow(2, 3)"), maxlang::Value(8.0));
+    first.context().variables.erase("e");
+    EXPECT_FALSE(first.context().variables.contains("e"));
+    EXPECT_TRUE(second.context().variables.contains("e"));
+}
+
+TEST(Eblang, TypedNativeFunction) {
+    maxlang::State g;
+    g.bind("Hypot", +[](double a, double b) { return std::sqrt(a * a + b * b); }, true);
+    g.bind("Repeat", +[](const maxlang::String& text, int count) {
+        std::string result;
+        for (int k = 0; k < count; ++k) {
+            result += text.str();
+        }
+        return maxlang::String(result);
+    });
+    // Лямбда без захвата видит только статические переменные
+    static int calls = 0;
+    g.bind("Count", +[](maxlang::Context&, bool enabled) { calls += enabled; });
+
+    EXPECT_EQ(g.evaluate("Hypot(3, 4)"), maxlang::Value(5.0));
+    EXPECT_EQ(g.evaluate("Repeat('ab', 3)"), maxlang::Value("ababab"));
+    g.run("for (i = 0; i < 10; i++) { Count(i < 5); }");
+    EXPECT_EQ(calls, 5);
+    EXPECT_EQ(maxlang::vm::call(g.context().functions["Hypot"], g.context(), { 6, 8.0 }), maxlang::Value(10.0));
+
+    EXPECT_THROW(g.evaluate("Hypot(1)"), std::runtime_error);
+    EXPECT_THROW(g.evaluate("Repeat(1, 2)"), std::runtime_error);
+    EXPECT_THROW(g.evaluate("Hypot('a', 1)"), std::runtime_error);
+}
+
+TEST(Eblang, PrintCyclicArray) {
+    maxlang::State g;
+    g.run("a = [0, 1]; a[0] = a; b = [a, a];");
+    std::ostringstream os;
+    os << g.context().variables["b"];
+    EXPECT_EQ(os.str(), "[[[...], 1], [[...], 1]]");
+
+    os.str("");
+    maxlang::printArray(os, *std::get<maxlang::ArrayRef>(g.context().variables["a"]));
+    EXPECT_EQ(os.str(), "Array '': [[...], 1]");
+    // Цикл разрывается, чтобы массивы освободились вместе с контекстом
+    g.run("a[0] = 0;");
+}
+
+TEST(Eblang, CorruptedCacheOperands) {
+    maxlang::State g;
+    auto program = g.compile("fn f(n) { while (n > 0) { n = n - 1; } return n; } x = f(3);");
+    auto valid = maxlang::cache::save({ program.chunk() }, 1);
+    ASSERT_TRUE(maxlang::cache::load(valid, 1).has_value());
+
+    // Заголовок, число chunk и число инструкций первого chunk
+    size_t code = 4 + sizeof(uint32_t) + sizeof(uint64_t) + 2 * sizeof(uint32_t);
+    auto corrupt = [&](size_t instruction, size_t operand) {
+        auto data = valid;
+        data[code + instruction * sizeof(maxlang::bytecode::Instruction) + operand + 1] = '\x7f';
+        return data;
+    };
+    using maxlang::bytecode::Instruction;
+    size_t rejected = 0;
+    for (size_t k = 0; k < program.chunk().code.size(); ++k) {
+        for (size_t operand : { offsetof(Instruction, a), offsetof(Instruction, b), offsetof(Instruction, c) }) {
+            auto chunks = maxlang::cache::load(corrupt(k, operand), 1);
+            if (!chunks) {
+                ++rejected;
+                continue;
+            }
+            // Принятый код изменился только в неиспользуемых операндах
+            maxlang::State h;
+            for (const auto& chunk : *chunks) {
+                maxlang::vm::run(chunk, h.context());
+            }
+            EXPECT_EQ(h.context().variables["x"], maxlang::Value(0));
+        }
+    }
+    EXPECT_GT(rejected, program.chunk().code.size());
+    EXPECT_FALSE(maxlang::cache::load(corrupt(0, offsetof(Instruction, a)), 1).has_value());
+}
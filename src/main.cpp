@@ -1,27 +1,142 @@
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAXLANG_MMAP 1
+#endif
 
 #include "maxlang/state.h"
 #include "maxlang/stdlib.h"
 
+namespace {
+    /**
+     * @brief Program text: a read-only mapping of a regular file, or a copy read through a stream
+     * for pipes, stdin and platforms without mmap.
+     */
+    class Source {
+    public:
+        Source() = default;
+        Source(const Source&) = delete;
+        Source& operator=(const Source&) = delete;
+
+        ~Source() {
+#ifdef MAXLANG_MMAP
+            if (mMapping) {
+                munmap(mMapping, mSize);
+            }
+#endif
+        }
+
+        /**
+         * @brief Returns std::nullopt if the file cannot be opened.
+         */
+        static std::optional<Source> open(const std::string& path);
+
+        static Source read(std::istream& stream) {
+            Source source;
+            source.mText.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+            return source;
+        }
+
+        Source(Source&& other) noexcept
+            : mMapping(std::exchange(other.mMapping, nullptr)), mSize(other.mSize), mText(std::move(other.mText)) {}
+
+        std::string_view code() const {
+            return mMapping ? std::string_view(static_cast<const char*>(mMapping), mSize) : std::string_view(mText);
+        }
+
+    private:
+        void* mMapping = nullptr;
+        size_t mSize = 0;
+        std::string mText;
+    };
+
+    std::optional<Source> Source::open(const std::string& path) {
+#ifdef MAXLANG_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return std::nullopt;
+        }
+        Source source;
+        struct stat info {};
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+            void* mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                // Отображение остаётся действительным и после закрытия файла
+                close(fd);
+                source.mMapping = mapping;
+                source.mSize = static_cast<size_t>(info.st_size);
+                return source;
+            }
+        }
+        // Каналы читаются из уже открытого дескриптора: повторное открытие потеряло бы данные
+        char buffer[64 * 1024];
+        for (ssize_t size; (size = ::read(fd, buffer, sizeof(buffer))) != 0;) {
+            if (size < 0) {
+                close(fd);
+                return std::nullopt;
+            }
+            source.mText.append(buffer, static_cast<size_t>(size));
+        }
+        close(fd);
+        return source;
+#else
+        std::ifstream fis(path, std::ios::binary);
+        if (!fis.good()) {
+            return std::nullopt;
+        }
+        return read(fis);
+#endif
+    }
+
+    void run(maxlang::State& state, std::string_view code, const std::string* cachePath) {
+        if (std::getenv("MAXLANG_DEBUG_FOLDING")) {
+            // Свёртка происходит только при компиляции, поэтому кэш не используется
+            state.setFoldingLog(&std::cerr);
+            state.runStreaming(code);
+        } else if (!cachePath || std::getenv("MAXLANG_NO_CACHE")) {
+            state.runStreaming(code);
+        } else {
+            state.runCached(code, *cachePath);
+        }
+    }
+}
+
 int main(int argc, char** argv) {
     if (argc != 2) {
         std::cout << R"(Usage: maxlang <file>
 
-file: path to program file.
+file: path to program file without the .mpp extension, or - to read the program from stdin.
 )";
+        return 1;
     }
+
+    maxlang::State state;
+    maxlang::stdlib::init(state);
+
+    if (std::string_view(argv[1]) == "-") {
+        auto source = Source::read(std::cin);
+        run(state, source.code(), nullptr);
+        return 0;
+    }
+
     std::string file  = argv[1];
     file += ".mpp";
-    std::ifstream fis(file, std::ios::binary);
-    if (!fis.good()) {
+    auto source = Source::open(file);
+    if (!source) {
         std::cout << "Failed to open file: " << argv[1] << std::endl;
         return 1;
     }
-    std::string code((std::istreambuf_iterator<char>(fis)), std::istreambuf_iterator<char>());
-
-    maxlang::State state;
-    maxlang::stdlib::init(state);
-    state.run(code);
+    auto cachePath = file + "c";
+    run(state, source->code(), &cachePath);
     return 0;
-}
\ No newline at end of file
+}